@@ -0,0 +1,115 @@
+// created by Davide Baggio 2122547
+
+#ifndef ANNOTATION_OUTPUT_HPP
+#define ANNOTATION_OUTPUT_HPP
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+// aggregated annotations of a run, inside the output directory
+const static string annotations_file = "annotations.jsonl";
+
+/*
+ * Format of the annotations written for the test frames.
+ *
+ * - ANNOTATIONS_TEXT: a `<frame>-box.txt` file per frame, one "<class> x1 y1 x2 y2" line per category.
+ * - ANNOTATIONS_JSONL: one `annotations.jsonl` file per run, one JSON line per frame appended as the frames are
+ *   processed, such as {"frame":"0001","boxes":[{"class":"004_sugar_box","x1":10,"y1":20,"x2":110,"y2":220}]}.
+ */
+enum annotation_format
+{
+	ANNOTATIONS_TEXT,
+	ANNOTATIONS_JSONL
+};
+
+/*
+ * Parses the name of an annotation format: "text" or "jsonl".
+ *
+ * Returns:
+ * - False if the name is not a known format.
+ */
+bool parse_annotation_format(const string &name, annotation_format &format);
+
+/*
+ * Formats the boxes of a frame as a JSONL annotation line, ending with a newline.
+ *
+ * Parameters:
+ * - frame: Name of the frame.
+ * - names: Class name of each category.
+ * - boxes: Box found for each category, in native coordinates.
+ * - line: Output line, its capacity is reused.
+ */
+void format_annotation_line(const string &frame, const vector<string> &names, const vector<Rect> &boxes, string &line);
+
+/*
+ * Writes the annotations of the frames of a run.
+ *
+ * In JSONL format the file is opened once and every frame is appended to it, flushed only by the stream buffer
+ * and at close, so a frame costs a buffered write instead of a file creation.
+ */
+class annotation_writer
+{
+private:
+	annotation_format format;
+	string output_dir;
+
+	// aggregated file, open for the whole run in JSONL format
+	ofstream jsonl;
+
+	// line of the current frame, reused across frames
+	string line;
+
+public:
+	/*
+	 * Parameters:
+	 * - format: Format of the annotations.
+	 * - output_dir: Directory the annotations are written to, ending with '/'.
+	 */
+	annotation_writer(annotation_format format, const string &output_dir);
+
+	/*
+	 * Creates the aggregated file, replacing the one of a previous run.
+	 *
+	 * Returns:
+	 * - False if the file cannot be created.
+	 */
+	bool open();
+
+	/*
+	 * Writes the boxes found in a frame.
+	 *
+	 * Parameters:
+	 * - frame: Name of the frame, as returned by `get_filename`.
+	 * - names: Class name of each category.
+	 * - boxes: Box found for each category, in native coordinates.
+	 *
+	 * Returns:
+	 * - False if the annotations cannot be written.
+	 */
+	bool write(const string &frame, const vector<string> &names, const vector<Rect> &boxes);
+
+	/*
+	 * Flushes and closes the aggregated file.
+	 */
+	void close();
+};
+
+/*
+ * Reads an aggregated annotation file with a single sequential scan.
+ *
+ * Parameters:
+ * - path: Path of the JSONL file.
+ * - frames: Filled with the boxes of every frame by class name, a frame written twice keeps its last line.
+ *
+ * Returns:
+ * - False if the file cannot be opened.
+ */
+bool read_annotations(const string &path, map<string, map<string, Rect>> &frames);
+
+#endif // ANNOTATION_OUTPUT_HPP
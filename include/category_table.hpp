@@ -0,0 +1,85 @@
+// created by Davide Baggio 2122547
+
+#ifndef CATEGORY_TABLE_HPP
+#define CATEGORY_TABLE_HPP
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+// optional file of a category listing the colors its HAAR points must have, such as "yellow white"
+const static string colors_file = "colors.txt";
+
+/*
+ * Category of the dataset, one folder of the data directory.
+ */
+struct category_info
+{
+	// folder of the category inside the data directory, such as "004_sugar_box/"
+	string folder;
+	// class name of the category in the labels and annotations, such as "004_sugar_box"
+	string name;
+	// colors accepted by the color check of the category, empty accepts every color
+	vector<bool (*)(Vec3b)> colors;
+	// color of its boxes and points when drawn
+	Scalar display_color;
+
+	/*
+	 * Returns true if a pixel has one of the accepted colors of the category.
+	 */
+	bool accept_color(Vec3b pixel) const;
+};
+
+/*
+ * Discovers the categories of a data directory.
+ *
+ * Parameters:
+ * - data_dir: Data directory, read from the dataset pack if one is open.
+ *
+ * Returns:
+ * - One entry per folder holding a `models` folder, sorted by name.
+ *
+ * Behavior:
+ * - Unknown names in `colors.txt` are reported and ignored.
+ */
+vector<category_info> discover_categories(const string &data_dir);
+
+/*
+ * Returns the categories of the dataset, discovered in `base` by the first call that finds any.
+ *
+ * Behavior:
+ * - A dataset pack must be opened before the discovery to be used for it.
+ * - The table is empty if the data directory has no category, the callers report it. The discovery runs again
+ *   on the next call, until it finds a category, then the table never changes.
+ */
+const vector<category_info> &get_categories();
+
+/*
+ * Returns true once the categories have been discovered, without running the discovery.
+ */
+bool categories_discovered();
+
+/*
+ * Returns the number of categories of the dataset.
+ */
+int get_num_categories();
+
+/*
+ * Returns the class name of every category, in category order.
+ */
+vector<string> get_category_names();
+
+/*
+ * Returns the folder of the model views of every category, in category order.
+ */
+vector<string> get_model_paths();
+
+/*
+ * Lists the test images of every category, in category order.
+ */
+vector<String> get_test_images();
+
+#endif // CATEGORY_TABLE_HPP
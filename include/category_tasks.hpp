@@ -0,0 +1,56 @@
+// created by Davide Baggio 2122547
+
+#ifndef CATEGORY_TASKS_HPP
+#define CATEGORY_TASKS_HPP
+
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+/*
+ * Runs `count` independent tasks, in parallel on the OpenCV thread pool or one after another.
+ *
+ * Parameters:
+ * - count: Number of tasks.
+ * - parallel: Run the tasks in parallel.
+ * - task: Callable taking the task index, it may read shared data but must write only to the buffers of its task.
+ *
+ * Behavior:
+ * - Returns once every task is done. OpenCV calls made by the tasks that would use the thread pool
+ *   themselves run serially inside their task.
+ * - The tasks must not depend on the order they run in, so parallel and serial runs give the same result.
+ */
+template <typename indexed_task>
+void run_tasks(int count, bool parallel, const indexed_task &task)
+{
+	if (!parallel || count < 2)
+	{
+		for (int k = 0; k < count; k++)
+			task(k);
+		return;
+	}
+
+	parallel_for_(Range(0, count), [&](const Range &range)
+				  {
+					  for (int k = range.start; k < range.end; k++)
+						  task(k);
+				  },
+				  count);
+}
+
+/*
+ * Runs a task for every category of a frame, as `run_tasks` does.
+ *
+ * Parameters:
+ * - num_categories: Number of categories.
+ * - parallel: Run the categories as parallel tasks.
+ * - task: Callable taking the category index, writing only to the buffers of its category.
+ */
+template <typename category_task>
+void run_category_tasks(int num_categories, bool parallel, const category_task &task)
+{
+	run_tasks(num_categories, parallel, task);
+}
+
+#endif // CATEGORY_TASKS_HPP
@@ -0,0 +1,175 @@
+// created by Davide Baggio 2122547
+
+#ifndef DATASET_PACK_HPP
+#define DATASET_PACK_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+/*
+ * Single indexed file holding the whole dataset (test images, labels, models, negatives, cascades).
+ *
+ * Layout:
+ * - A 64 byte header: magic, version, number of entries, offset and size of the index.
+ * - The content of every entry, each starting on a 64 byte boundary.
+ * - The index: for each entry its offset, size, kind, image geometry and name (path relative to the dataset root).
+ *
+ * Images are stored either encoded, as their original file, or raw, as decoded pixels that are used in place
+ * without decoding. The pack is memory-mapped copy-on-write, so the frames returned for raw images can be
+ * drawn on without changing the file.
+ */
+class dataset_pack
+{
+private:
+	// entry of the index
+	struct entry
+	{
+		uint64_t offset = 0;
+		uint64_t size = 0;
+		// 0 for a file stored as is, 1 for a raw image
+		uint32_t kind = 0;
+		int32_t rows = 0;
+		int32_t cols = 0;
+		int32_t type = 0;
+	};
+
+	// mapping of the whole file
+	uchar *mapping = nullptr;
+	size_t mapping_size = 0;
+
+	// entries by name, sorted so that the files of a directory are contiguous
+	map<string, entry> entries;
+
+	void close();
+
+public:
+	dataset_pack() = default;
+	dataset_pack(const dataset_pack &) = delete;
+	dataset_pack &operator=(const dataset_pack &) = delete;
+	~dataset_pack();
+
+	/*
+	 * Packs every file under a dataset directory.
+	 *
+	 * Parameters:
+	 * - data_dir: Root of the dataset, names are relative to it.
+	 * - pack_path: Output file.
+	 * - raw_images: Store the jpg and png images decoded, so they are read without decoding.
+	 *
+	 * Returns:
+	 * - False if a file cannot be read or the pack cannot be written.
+	 */
+	static bool write(const string &data_dir, const string &pack_path, bool raw_images);
+
+	/*
+	 * Memory-maps a pack and reads its index.
+	 *
+	 * Returns:
+	 * - False if the file cannot be mapped or is not a valid pack, such as an entry out of the file or a raw image
+	 *   whose size does not match its geometry.
+	 */
+	bool open(const string &pack_path);
+
+	bool is_open() const;
+
+	/*
+	 * Returns true if the pack contains a file.
+	 */
+	bool contains(const string &name) const;
+
+	/*
+	 * Returns the bytes of a file stored as is, in place.
+	 *
+	 * Returns:
+	 * - False if the entry does not exist or is a raw image (read with `get_image`).
+	 */
+	bool get_bytes(const string &name, const uchar *&data, size_t &size) const;
+
+	/*
+	 * Returns an image of the pack, decoded from the stored file or wrapped in place if stored raw.
+	 *
+	 * Parameters:
+	 * - name: Name of the image.
+	 * - flags: imread flags, IMREAD_COLOR or IMREAD_GRAYSCALE for raw images.
+	 *
+	 * Returns:
+	 * - The image, empty if the entry does not exist or cannot be decoded.
+	 */
+	Mat get_image(const string &name, int flags) const;
+
+	/*
+	 * Returns the names of the files directly inside a directory of the pack, in sorted order.
+	 */
+	vector<string> list(const string &dir) const;
+
+	/*
+	 * Returns the names of the directories directly inside a directory of the pack, in sorted order.
+	 */
+	vector<string> list_dirs(const string &dir) const;
+};
+
+/*
+ * Dataset access shared by the executables. Once a pack is opened every path under the dataset root is read
+ * from it, otherwise from the filesystem.
+ */
+
+/*
+ * Opens the pack the dataset is read from.
+ *
+ * Returns:
+ * - False if the pack cannot be opened, the filesystem is used.
+ */
+bool open_dataset_pack(const string &pack_path);
+
+/*
+ * Returns true if the dataset is read from a pack.
+ */
+bool dataset_pack_open();
+
+/*
+ * Returns the path the open pack was opened with, empty if the dataset is read from the filesystem.
+ */
+string dataset_pack_path();
+
+/*
+ * Lists the files matching a pattern with at most one `*` in the file name, sorted like cv::glob.
+ */
+void glob_dataset(const string &pattern, vector<String> &result);
+
+/*
+ * Lists the paths of the files directly inside a directory of the dataset, sorted.
+ */
+vector<string> list_dataset(const string &dir);
+
+/*
+ * Lists the paths of the directories directly inside a directory of the dataset, sorted, empty if it does not exist.
+ */
+vector<string> list_dataset_dirs(const string &dir);
+
+/*
+ * Reads an image of the dataset, like cv::imread.
+ */
+Mat read_dataset_image(const string &path, int flags = IMREAD_COLOR);
+
+/*
+ * Returns the encoded bytes of a file of the pack in place.
+ *
+ * Returns:
+ * - False if no pack is open, the file is not in the pack or it is stored as a raw image.
+ */
+bool read_dataset_bytes(const string &path, const uchar *&data, size_t &size);
+
+/*
+ * Reads a text file of the dataset.
+ *
+ * Returns:
+ * - False if the file cannot be read.
+ */
+bool read_dataset_text(const string &path, string &text);
+
+#endif // DATASET_PACK_HPP
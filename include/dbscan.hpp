@@ -73,18 +73,68 @@ void expand_cluster(const vector<Point> &points, vector<int> &labels, int idx, i
 cluster_result dbscan(const vector<Point> &points, float eps, int min_points);
 
 /*
- * Identifies and returns the bounding rectangle of the densest cluster found using DBSCAN.
+ * Structure that describes the densest cluster of a set of points
+ */
+struct cluster_quality
+{
+	// bounding rectangle of the densest cluster, empty if there is none
+	Rect box;
+	// number of points in the densest cluster
+	size_t cluster_size = 0;
+	// number of points clustered
+	size_t total_points = 0;
+	// fraction of the points that belong to the densest cluster
+	float concentration = 0.0f;
+	// total weight of the densest cluster, its size for unweighted points
+	float cluster_weight = 0.0f;
+};
+
+/*
+ * Points with a weight, stored as one structure-of-arrays buffer. Clearing keeps the capacity.
+ */
+struct weighted_points
+{
+	vector<Point> points;
+	vector<float> weights;
+
+	void clear()
+	{
+		points.clear();
+		weights.clear();
+	}
+
+	void push(const Point &pt, float weight)
+	{
+		points.push_back(pt);
+		weights.push_back(weight);
+	}
+
+	size_t size() const { return points.size(); }
+	bool empty() const { return points.empty(); }
+};
+
+/*
+ * Finds the densest cluster of weighted points with a weighted-density DBSCAN.
  *
  * Parameters:
- * - points: The dataset of points.
- * - eps: Radius to consider for neighborhood points (default: 30.0).
- * - min_points: Minimum number of points required to form a cluster (default: 5).
+ * - input: The points and their weights.
+ * - eps: Radius to consider for neighborhood points.
+ * - min_weight: Minimum total weight of the neighborhood of a core point (a point of weight 1 counts as one point).
  *
  * Returns:
- * - A `Rect` representing the bounding rectangle of the densest cluster.
- * - Returns an empty rectangle if no clusters are found.
+ * - A `cluster_quality` with the box of the cluster of largest total weight, its number of points, its weight
+ *   and the fraction of the total weight it holds.
+ *
+ * Behavior:
+ * - Points are visited in input order and ties keep the first cluster found, so the result is deterministic.
+ * - With unit weights it finds the same clusters as `dbscan` with `min_points` equal to `min_weight`.
+ */
+cluster_quality get_weighted_cluster(const weighted_points &input, float eps, float min_weight);
+
+/*
+ * Returns the bounding rectangle of the densest weighted cluster, empty if there is none.
  */
-Rect get_dense_cluster(const vector<Point> &points, float eps, int min_points);
+Rect get_dense_cluster(const weighted_points &input, float eps, float min_weight);
 
 /*
  * Visualizes clusters, noise points, and the bounding box of the densest cluster using OpenCV.
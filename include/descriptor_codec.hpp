@@ -0,0 +1,107 @@
+// created by Davide Baggio 2122547
+
+#ifndef DESCRIPTOR_CODEC_HPP
+#define DESCRIPTOR_CODEC_HPP
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+/*
+ * Storage of the float descriptors (SIFT)
+ * - DESCRIPTOR_FLOAT: 32 bit floats, as computed.
+ * - DESCRIPTOR_UINT8: each component saturated to 8 bits, SIFT components already lie in [0, 255].
+ * - DESCRIPTOR_PCA: projection on the first principal components of the model descriptors.
+ */
+enum descriptor_mode
+{
+	DESCRIPTOR_FLOAT,
+	DESCRIPTOR_UINT8,
+	DESCRIPTOR_PCA
+};
+
+/*
+ * Parses the name of a descriptor mode: "float", "uint8", "pca32" or "pca64".
+ *
+ * Parameters:
+ * - name: Name of the mode.
+ * - mode: Output, the parsed mode.
+ * - dims: Output, the number of components of the PCA modes, 0 otherwise.
+ *
+ * Returns:
+ * - False if the name is not a known mode.
+ */
+bool parse_descriptor_mode(const string &name, descriptor_mode &mode, int &dims);
+
+/*
+ * Encodes float descriptors into a compact form and matches them directly in that form.
+ *
+ * The model descriptors are encoded once at load time, the descriptors of each frame before matching,
+ * so model and frame always share the same representation.
+ */
+class descriptor_codec
+{
+private:
+	descriptor_mode mode = DESCRIPTOR_FLOAT;
+
+	// number of principal components kept by DESCRIPTOR_PCA
+	int dims = 0;
+
+	// projection of DESCRIPTOR_PCA, fitted on the model descriptors
+	PCA pca;
+
+public:
+	/*
+	 * Parameters:
+	 * - mode: Storage of the descriptors.
+	 * - dims: Number of principal components, used only by DESCRIPTOR_PCA.
+	 */
+	descriptor_codec(descriptor_mode mode = DESCRIPTOR_FLOAT, int dims = 0);
+
+	/*
+	 * Returns true if the descriptors are stored in a compact form.
+	 */
+	bool compact() const;
+
+	/*
+	 * Fits the PCA projection on the descriptors of every model view (nothing to fit for the other modes).
+	 */
+	void train(const vector<vector<Mat>> &model_descriptors);
+
+	/*
+	 * Returns the compact form of float descriptors, one row per descriptor.
+	 */
+	Mat encode(const Mat &descriptors) const;
+
+	/*
+	 * Finds the `k` nearest frame descriptors of each model descriptor, both in compact form.
+	 *
+	 * Behavior:
+	 * - Exact brute force L2 search on the compact rows: integer sums of squared differences for
+	 *   DESCRIPTOR_UINT8, float sums over the reduced dimensions for DESCRIPTOR_PCA.
+	 */
+	void knn_match(const Mat &model_desc, const Mat &img_desc, vector<vector<DMatch>> &matches, int k) const;
+
+	/*
+	 * Measures the fraction of the ratio test matches of the float descriptors kept by the compact ones.
+	 *
+	 * Parameters:
+	 * - model_descriptors: Float descriptors of every model view.
+	 * - ratio: Ratio of the Lowe's test.
+	 * - max_pairs: Maximum number of pairs of consecutive views of a category matched against each other.
+	 *
+	 * Returns:
+	 * - The recall of the compact matches, 1 if no pair could be matched.
+	 */
+	float measure_recall(const vector<vector<Mat>> &model_descriptors, float ratio, int max_pairs = 20) const;
+
+	/*
+	 * Returns the name of the mode, as accepted by `parse_descriptor_mode`.
+	 */
+	string name() const;
+};
+
+#endif // DESCRIPTOR_CODEC_HPP
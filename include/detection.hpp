@@ -5,21 +5,56 @@
 
 #include <iostream>
 #include <fstream>
+#include <map>
 #include <opencv2/opencv.hpp>
+#include "annotation_output.hpp"
 
 using namespace std;
 using namespace cv;
 
 // CONSTANTS
 const static string base = "./data/";
-const static string sugar = "004_sugar_box/";
-const static string mustard = "006_mustard_bottle/";
-const static string drill = "035_power_drill/";
 const static string img_path = "test_images/*.jpg";
 const static string label_path = "labels/";
 const static string models_path = "models/*_mask.png";
 const static string negative_path = "negative_images/";
 const static string cascade = "object_cascade/cascade.xml";
+const static string cascade_lbp = "object_cascade_lbp/cascade.xml";
+
+// multi-scale detection parameters of the cascades
+const static double cascade_scale_factor = 1.1;
+const static int cascade_min_neighbors = 2;
+
+/*
+ * Features of a trained cascade, each stored in its own folder of a category.
+ */
+enum cascade_type
+{
+	CASCADE_HAAR,
+	CASCADE_LBP
+};
+
+/*
+ * Parses the name of a cascade type: "haar" or "lbp".
+ *
+ * Returns:
+ * - False if the name is not a known type.
+ */
+bool parse_cascade_type(const string &name, cascade_type &type);
+
+/*
+ * Returns the name of a cascade type, as accepted by `parse_cascade_type`.
+ */
+string get_cascade_type_name(cascade_type type);
+
+/*
+ * Returns the path of the cascade of a category.
+ *
+ * Parameters:
+ * - category: Folder of the category, such as "004_sugar_box/".
+ * - type: Features of the cascade.
+ */
+string get_cascade_path(const string &category, cascade_type type);
 
 /*
  * Extracts and returns the base filename from a given file path, ignoring file extension or additional suffixes.
@@ -32,6 +67,62 @@ const static string cascade = "object_cascade/cascade.xml";
  */
 string get_filename(string path);
 
+/*
+ * Returns the path of the label file of a test image.
+ *
+ * Parameters:
+ * - image_path: Path of an image in the `test_images` folder of a category.
+ *
+ * Returns:
+ * - The path of the matching `labels/<filename>-box.txt` file of the same category.
+ */
+string get_label_path(string image_path);
+
+/*
+ * Reads the boxes of a label or annotation file, one "<class> x1 y1 x2 y2" line per object.
+ *
+ * Parameters:
+ * - path: Path of the file.
+ *
+ * Returns:
+ * - A map from class name to box, empty if the file cannot be opened.
+ */
+map<string, Rect> read_boxes(string path);
+
+/*
+ * Accumulated detection statistics over a set of frames.
+ */
+struct detection_score
+{
+	// objects detected with IoU above 0.5
+	int detected = 0;
+	// labelled objects evaluated
+	int total = 0;
+	// sum of the IoU of the evaluated objects
+	float iou_total = 0.0f;
+
+	/*
+	 * Adds the IoU of one labelled object.
+	 */
+	void add(float iou);
+
+	/*
+	 * Returns the average IoU, 0 if no object was evaluated.
+	 */
+	float average_iou() const;
+};
+
+/*
+ * Scores the boxes found in a frame against its labels.
+ *
+ * Parameters:
+ * - labels: Ground truth boxes of the frame, by class name.
+ * - names: Class name of each category.
+ * - boxes: Box found for each category.
+ * - score: Statistics updated with every labelled category.
+ */
+void score_frame(const map<string, Rect> &labels, const vector<string> &names, const vector<Rect> &boxes, detection_score &score);
+
 /*
  * Checks if a pixel color is considered yellow based on BGR values.
  *
@@ -104,13 +195,16 @@ float intersection_over_union(Rect rect1, Rect rect2);
  *
  * It computes the number of correctly detected objects and the average Intersection over Union (IoU).
  *
+ * Parameters:
+ * - format: Format the annotations of the last run were written in.
+ *
  * Behavior:
- * - Reads tested annotations from the 'output' folder.
+ * - Reads tested annotations from the 'output' folder, the aggregated file in a single scan in JSONL format.
  * - Reads ground truth labels for different object classes.
  * - Matches files based on filename.
  * - Compares bounding boxes and calculates IoU for each object.
  * - Prints out per-object IoU and overall detection statistics.
  */
-void display_performances();
+void display_performances(annotation_format format = ANNOTATIONS_JSONL);
 
 #endif // DETECTION_HPP
\ No newline at end of file
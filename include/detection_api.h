@@ -0,0 +1,176 @@
+// created by Davide Baggio 2122547
+
+#ifndef DETECTION_API_H
+#define DETECTION_API_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// DETECTION_API_BUILD is defined only when building the library, the programs using it import the functions
+#if defined(_WIN32) && defined(DETECTION_API_BUILD)
+#define DETECTION_API __declspec(dllexport)
+#elif defined(_WIN32)
+#define DETECTION_API __declspec(dllimport)
+#else
+#define DETECTION_API __attribute__((visibility("default")))
+#endif
+
+// version of the interface, raised when a struct or a function changes
+#define DETECTION_API_VERSION 1
+
+/*
+ * Embeddable interface of the detection pipeline, exported by the `object_detection` shared library.
+ *
+ * A context owns the loaded models and the buffers of the frames: it is created once, then every frame is
+ * processed without loading anything, copying the frame when it is already BGR or printing anything.
+ * A context processes one frame at a time, threads processing frames concurrently need one context each.
+ * No function of the interface exits the process or lets an exception through.
+ */
+typedef struct detection_context detection_context;
+
+typedef enum detection_status
+{
+	DETECTION_OK = 0,
+	// a pointer is null, the frame has no pixels, an option is out of range or the dataset is not the open one
+	DETECTION_ERROR_ARGUMENT = -1,
+	// the dataset, the categories or a cascade cannot be loaded
+	DETECTION_ERROR_LOAD = -2,
+	// the box array has fewer entries than categories
+	DETECTION_ERROR_CAPACITY = -3,
+	// the memory of the models or of a frame cannot be allocated
+	DETECTION_ERROR_MEMORY = -4,
+	// an error raised by OpenCV while processing
+	DETECTION_ERROR_INTERNAL = -5
+} detection_status;
+
+/*
+ * Layout of the pixels of a frame, 8 bits per channel.
+ */
+typedef enum detection_format
+{
+	DETECTION_FORMAT_BGR = 0,
+	DETECTION_FORMAT_RGB = 1,
+	DETECTION_FORMAT_BGRA = 2,
+	DETECTION_FORMAT_RGBA = 3,
+	DETECTION_FORMAT_GRAY = 4
+} detection_format;
+
+/*
+ * Frame owned by the caller, read in place and never kept after `detection_detect` returns.
+ */
+typedef struct detection_frame
+{
+	const unsigned char *data;
+	int width;
+	int height;
+	// bytes from the start of a row to the start of the next one, 0 for tightly packed rows
+	size_t stride;
+	detection_format format;
+} detection_frame;
+
+/*
+ * Box of a category in frame coordinates, `found` is 0 and the box is empty when the category is not detected.
+ */
+typedef struct detection_box
+{
+	int category;
+	int found;
+	int x;
+	int y;
+	int width;
+	int height;
+} detection_box;
+
+/*
+ * Options of a context, as the command line options of `test_images_detection` with the same names.
+ */
+typedef struct detection_options
+{
+	// processing resolution as a fraction of the frame one (0 < scale <= 1), boxes are in frame coordinates
+	float scale;
+	// expansion of the HAAR detections used as regions for ORB and SIFT, 0 extracts on the full frame
+	float roi_expand;
+	// refine the boxes at frame resolution when `scale` is below 1
+	int refine;
+	// time budget in milliseconds of the ORB and SIFT stages of a frame and their keypoint limit, 0 disables it
+	double feature_budget_ms;
+	int max_keypoints;
+	// model views matched per category after the vocabulary tree preselection, 0 matches every view
+	int candidate_views;
+	// count `candidate_views` across all categories instead of per category
+	int shared_views;
+	// stop matching the views of a category once the others cannot win
+	int bounded_views;
+	// process frames larger than `tile_size` pixels per side as tiles with a halo, 0 processes whole frames
+	int tile_size;
+	int tile_halo;
+	// run the categories and the model views of a frame as parallel tasks on the OpenCV thread pool
+	int parallel;
+} detection_options;
+
+/*
+ * Fills the options with the defaults of `test_images_detection`.
+ */
+DETECTION_API void detection_default_options(detection_options *options);
+
+/*
+ * Loads the categories, cascades and model views and creates a context.
+ *
+ * Parameters:
+ * - dataset_pack: Pack written by `pack_dataset` the models are read from, null reads the `./data/` directory.
+ * - options: Options of the context, null uses the defaults.
+ * - context: Output, the created context, null on failure.
+ *
+ * Behavior:
+ * - The dataset and its categories are shared by every context of the process: the first context opens them,
+ *   the following ones must be created with the same pack path (or null for all), otherwise
+ *   DETECTION_ERROR_ARGUMENT is returned.
+ * - A context that finds no category fails with DETECTION_ERROR_LOAD, the next one looks for them again.
+ * - Loading prints its progress, processing the frames does not.
+ */
+DETECTION_API detection_status detection_create(const char *dataset_pack, const detection_options *options, detection_context **context);
+
+/*
+ * Releases a context and its models, null is ignored.
+ */
+DETECTION_API void detection_destroy(detection_context *context);
+
+/*
+ * Returns the number of categories, the number of boxes `detection_detect` writes.
+ */
+DETECTION_API int detection_num_categories(const detection_context *context);
+
+/*
+ * Returns the class name of a category, owned by the context, or null if the index is out of range.
+ */
+DETECTION_API const char *detection_category_name(const detection_context *context, int category);
+
+/*
+ * Detects the box of every category in a frame.
+ *
+ * Parameters:
+ * - context: A context created by `detection_create`, not used by another thread at the same time.
+ * - frame: The frame, BGR frames are processed in place, the other formats are converted into a buffer of the
+ *   context reused across frames.
+ * - boxes: Output array of `capacity` entries, the box of category `c` is written to `boxes[c]`.
+ * - capacity: Number of entries of `boxes`, at least `detection_num_categories`.
+ *
+ * Returns:
+ * - DETECTION_OK, or the error that stopped the processing with the boxes left unspecified.
+ */
+DETECTION_API detection_status detection_detect(detection_context *context, const detection_frame *frame, detection_box *boxes, int capacity);
+
+/*
+ * Returns a static description of a status.
+ */
+DETECTION_API const char *detection_status_message(detection_status status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DETECTION_API_H
@@ -0,0 +1,159 @@
+// created by Davide Baggio 2122547
+
+#ifndef DETECTION_DAEMON_HPP
+#define DETECTION_DAEMON_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+// latencies kept for the percentiles of the counters
+const static size_t daemon_latency_window = 1024;
+
+// largest encoded image accepted in a request
+const static size_t daemon_max_image_bytes = 64 << 20;
+
+/*
+ * Frame of a request: an image path, or an encoded image sent in the request when the path is empty.
+ */
+struct daemon_request
+{
+	string path;
+	vector<uchar> image;
+};
+
+/*
+ * Latency and throughput counters of the daemon.
+ */
+struct daemon_stats
+{
+	// requests answered with boxes, requests that failed and requests being processed
+	size_t served = 0;
+	size_t failed = 0;
+	size_t active = 0;
+
+	// time from a request being read to its reply, and time spent waiting for a free worker, in seconds
+	double total_latency = 0;
+	double max_latency = 0;
+	double total_wait = 0;
+
+	// latencies of the last `daemon_latency_window` requests
+	vector<double> recent;
+	size_t next_recent = 0;
+};
+
+/*
+ * Detection service over a local Unix domain socket, answering requests with models loaded once.
+ *
+ * Each request is a single line, followed by the encoded image for `image`:
+ * - `path <file>`: detects the boxes of an image file (or of a dataset pack entry if a pack is open).
+ * - `image <bytes>`: detects the boxes of the `<bytes>` bytes of encoded image that follow the line.
+ * - `stats`: returns the latency and throughput counters.
+ * - `shutdown`: stops the daemon once the requests being processed are answered.
+ *
+ * Each reply is a single JSON line: the boxes of every category in the format of the JSONL annotations, the
+ * counters, or {"error":"..."}.
+ *
+ * Connections are served concurrently, each by its own thread, and the requests of a connection one after
+ * another. The frames are processed by a fixed set of workers, each owning its detectors and buffers, so at
+ * most as many frames as workers are processed at once and the others wait for a free worker.
+ */
+class detection_daemon
+{
+public:
+	/*
+	 * Detects the boxes of a request with a worker, in native frame coordinates.
+	 * Returns false if the frame cannot be read, an exception fails the request with an error reply.
+	 * A worker is never used by two requests at once.
+	 */
+	using frame_handler = function<bool(int worker, const daemon_request &request, vector<Rect> &boxes)>;
+
+private:
+	string socket_path;
+	vector<string> category_names;
+	int listen_fd = -1;
+	bool stopping = false;
+
+	// workers not processing a request
+	vector<int> free_workers;
+	mutex worker_lock;
+	condition_variable worker_ready;
+
+	// open connections, each served by its own thread
+	set<int> connections;
+	mutex connection_lock;
+	condition_variable connection_closed;
+
+	daemon_stats stats;
+	int64 start_ticks = 0;
+	mutable mutex stats_lock;
+
+	/*
+	 * Serves the requests of a connection until it is closed or the daemon stops.
+	 */
+	void serve(int fd, const frame_handler &handler);
+
+	/*
+	 * Processes a frame request with the first free worker and formats its reply.
+	 */
+	void detect(const daemon_request &request, const frame_handler &handler, vector<Rect> &boxes, string &reply);
+
+	/*
+	 * Records the latency of a request in the counters.
+	 */
+	void record(bool success, double latency, double wait);
+
+	/*
+	 * Stops accepting connections and wakes the threads blocked reading a connection.
+	 */
+	void stop();
+
+public:
+	/*
+	 * Parameters:
+	 * - socket_path: Path of the Unix domain socket, replaced if it already exists.
+	 * - workers: Number of frames processed at once, each worker index is passed to the handler.
+	 * - category_names: Class name of each category, written in the replies.
+	 */
+	detection_daemon(const string &socket_path, int workers, const vector<string> &category_names);
+
+	/*
+	 * Removes the socket file if the daemon is still listening.
+	 */
+	~detection_daemon();
+
+	/*
+	 * Accepts connections and answers their requests until a `shutdown` request.
+	 *
+	 * Parameters:
+	 * - handler: Detects the boxes of a frame request.
+	 *
+	 * Returns:
+	 * - False if the socket cannot be created.
+	 *
+	 * Behavior:
+	 * - Returns once every connection is closed, the socket file is removed.
+	 */
+	bool run(const frame_handler &handler);
+
+	/*
+	 * Returns the counters as a JSON line: requests served and failed, uptime, throughput, and the average,
+	 * median, 95th percentile and maximum latency in milliseconds.
+	 */
+	string format_stats() const;
+
+	/*
+	 * Prints the counters.
+	 */
+	void print_stats(ostream &out) const;
+};
+
+#endif // DETECTION_DAEMON_HPP
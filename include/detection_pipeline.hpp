@@ -0,0 +1,324 @@
+// created by Davide Baggio 2122547
+
+#ifndef DETECTION_PIPELINE_HPP
+#define DETECTION_PIPELINE_HPP
+
+#include <tuple>
+#include <type_traits>
+#include <cstdlib>
+#include <opencv2/opencv.hpp>
+#include "detector_base.hpp"
+#include "detection_result.hpp"
+#include "dbscan.hpp"
+
+using namespace std;
+using namespace cv;
+
+// weight kept by the points rejected by the color check of their detector
+const static float color_mismatch_weight = 0.2f;
+
+/*
+ * Appends the points of a detector block to the fused points of a category, weighted as described in
+ * `detection_pipeline::fuse`.
+ *
+ * Parameters:
+ * - points: The used points of the block, sorted by distance.
+ * - weight: Weight of the detector.
+ * - accepted: Callable `(size_t i)` returning true if the color check accepts the i-th point.
+ * - fused: Output buffer the points are appended to.
+ */
+template <typename color_check>
+void fuse_block(const point_view &points, float weight, const color_check &accepted, weighted_points &fused)
+{
+	if (points.empty())
+		return;
+
+	// blocks are sorted by distance, so the range of the used points is given by its ends
+	float best = points.distance(0);
+	float range = points.distance(points.size() - 1) - best;
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		float match = range > 0.0f ? 1.5f - (points.distance(i) - best) / range : 1.0f;
+		float color = accepted(i) ? 1.0f : color_mismatch_weight;
+		fused.push(points[i], weight * match * color);
+	}
+}
+
+/*
+ * Parameters of the adaptive (early exit) execution of the pipeline.
+ */
+struct cascade_params
+{
+	// confidence (0 to 1) every category must reach for the remaining detectors to be skipped
+	float threshold = 0.5f;
+	// size of the densest cluster that gives full confidence on the size
+	int target_points = 20;
+	// DBSCAN parameters of the confidence check, min_points is the weight a core neighbourhood must reach
+	float eps = 55.0f;
+	int min_points = 3;
+};
+
+/*
+ * Counters of the adaptive execution.
+ */
+struct cascade_stats
+{
+	size_t frames = 0;
+	// frames in which each detector ran or was skipped, indexed by detector id
+	size_t runs[DETECTOR_COUNT] = {};
+	size_t skips[DETECTOR_COUNT] = {};
+};
+
+/*
+ * Pipeline composed at compile time from a list of detectors.
+ *
+ * Template Parameters:
+ * - detectors: Detector classes deriving from `detector_base<detector>`, run in the given order.
+ *
+ * Behavior:
+ * - Holds references to detectors owned by the caller, so their models are loaded once.
+ * - Every call is expanded over the detector list at compile time, with no virtual calls.
+ * - The fusion reads the detector blocks of the frame result in place and appends every used point with
+ *   its weight straight into the caller's output buffer, without intermediate vectors.
+ */
+template <typename... detectors>
+class detection_pipeline
+{
+	static_assert(sizeof...(detectors) > 0, "a pipeline needs at least one detector");
+	static_assert((is_base_of<detector_base<detectors>, detectors>::value && ...), "every detector must derive from detector_base");
+
+private:
+	tuple<detectors &...> stages;
+
+public:
+	detection_pipeline(detectors &...stages) : stages(stages...) {}
+
+	/*
+	 * Runs every detector on `img`, in order, writing into `result`.
+	 */
+	void detect(const Mat &img, frame_result &result)
+	{
+		apply([&](auto &...d)
+			  { (d.detect(img, result), ...); },
+			  stages);
+	}
+
+	/*
+	 * Runs only the detectors that support regions, restricted to the regions of `result`.
+	 *
+	 * Parameters:
+	 * - img: The frame.
+	 * - result: Frame result holding the regions, the detectors write their blocks into it.
+	 *
+	 * Behavior:
+	 * - The region setting of every detector is restored afterwards.
+	 */
+	void detect_regions(const Mat &img, frame_result &result)
+	{
+		apply([&](auto &...d)
+			  { (run_in_regions(d, img, result), ...); },
+			  stages);
+	}
+
+	/*
+	 * Runs the detectors in order (cheapest first) and stops as soon as the points found so far
+	 * identify every category with enough confidence.
+	 *
+	 * Parameters:
+	 * - img: The frame.
+	 * - result: Frame result the detectors write into, blocks of skipped detectors stay empty.
+	 * - params: Confidence threshold and clustering parameters of the check.
+	 * - stats: Counters updated with the detectors that ran or were skipped.
+	 * - scratch: Reusable buffer for the fused points of the check.
+	 *
+	 * Returns:
+	 * - The number of detectors that ran.
+	 *
+	 * Behavior:
+	 * - After each detector but the last, every category is fused with the detectors run so far and
+	 *   the densest weighted cluster is scored as
+	 *   min(1, weight / target_points) * concentration * (detectors agreeing on the cluster / detectors run),
+	 *   where a detector agrees if any of its fused points falls in the cluster box.
+	 * - If every category scores at least `threshold`, the remaining detectors are skipped.
+	 */
+	size_t detect_adaptive(const Mat &img, frame_result &result, const cascade_params &params, cascade_stats &stats, weighted_points &scratch)
+	{
+		bool confident = false;
+		size_t stage = 0;
+		size_t ran = 0;
+		stats.frames++;
+		apply([&](auto &...d)
+			  { (run_stage(d, stage++, img, result, params, stats, scratch, confident, ran), ...); },
+			  stages);
+		return ran;
+	}
+
+	/*
+	 * Returns the confidence of a category given the points of the first `stages_run` detectors,
+	 * scored as described in `detect_adaptive`.
+	 */
+	float confidence(const Mat &img, const frame_result &result, int category, size_t stages_run, const cascade_params &params, weighted_points &scratch) const
+	{
+		fuse_prefix(img, result, category, stages_run, scratch);
+		cluster_quality quality = get_weighted_cluster(scratch, params.eps, static_cast<float>(params.min_points));
+		if (quality.box.empty() || stages_run == 0)
+			return 0.0f;
+
+		size_t agreeing = 0;
+		size_t stage = 0;
+		apply([&](const auto &...d)
+			  { ((agreeing += (stage++ < stages_run && agrees(d, img, result, category, quality.box)) ? 1 : 0), ...); },
+			  stages);
+
+		float size_score = min(1.0f, quality.cluster_weight / static_cast<float>(max(params.target_points, 1)));
+		return size_score * quality.concentration * static_cast<float>(agreeing) / static_cast<float>(stages_run);
+	}
+
+	/*
+	 * Displays the points of every detector.
+	 */
+	void display(const frame_result &result)
+	{
+		apply([&](auto &...d)
+			  { (d.display(result), ...); },
+			  stages);
+	}
+
+	/*
+	 * Fuses the points found by all detectors for a category.
+	 *
+	 * Parameters:
+	 * - img: The frame the points were detected in.
+	 * - result: The frame result filled by `detect`.
+	 * - category: Category to fuse.
+	 * - fused: Output buffer, cleared and filled with the fused points and their weights.
+	 *
+	 * Behavior:
+	 * - For each detector, takes its best points (`fused_points`) and keeps every one of them, weighted by
+	 *   the product of:
+	 *   - the detector weight;
+	 *   - the match distance, from 1.5 for the best match of the block down to 0.5 for the worst (1 when all
+	 *     the distances are equal, as for HAAR);
+	 *   - the color check, 1 if `accept_point` accepts the point and `color_mismatch_weight` otherwise.
+	 * - One pass per detector block, no sampling, so the same frame always gives the same output.
+	 * - The output keeps its capacity, so reusing it across frames avoids reallocations.
+	 */
+	void fuse(const Mat &img, const frame_result &result, int category, weighted_points &fused) const
+	{
+		fused.clear();
+		apply([&](const auto &...d)
+			  { (fuse_detector(d, img, result, category, fused), ...); },
+			  stages);
+	}
+
+	/*
+	 * Runs the color check of a detector on every point of its block, not only on the used ones.
+	 *
+	 * Parameters:
+	 * - img: The frame the points were detected in.
+	 * - result: The frame result filled by `detect`.
+	 * - category: Category of the block.
+	 * - id: Detector of the block, nothing is written if it is not in the pipeline.
+	 * - accepted: Output flags, cleared and filled with 1 for the accepted points and 0 for the others.
+	 */
+	void check_colors(const Mat &img, const frame_result &result, int category, detector_id id, vector<uint8_t> &accepted) const
+	{
+		accepted.clear();
+		apply([&](const auto &...d)
+			  { (check_detector_colors(d, img, result, category, id, accepted), ...); },
+			  stages);
+	}
+
+	/*
+	 * Returns the detector of type `detector` in the pipeline.
+	 */
+	template <typename detector>
+	detector &get()
+	{
+		return std::get<detector &>(stages);
+	}
+
+	// Number of detectors in the pipeline
+	static constexpr size_t size()
+	{
+		return sizeof...(detectors);
+	}
+
+private:
+	template <typename detector>
+	static void run_in_regions(detector &d, const Mat &img, frame_result &result)
+	{
+		if constexpr (detector::supports_regions)
+		{
+			bool previous = d.get_use_regions();
+			d.set_use_regions(true);
+			d.detect(img, result);
+			d.set_use_regions(previous);
+		}
+	}
+
+	template <typename detector>
+	void run_stage(detector &d, size_t stage, const Mat &img, frame_result &result, const cascade_params &params, cascade_stats &stats, weighted_points &scratch, bool &confident, size_t &ran)
+	{
+		if (confident)
+		{
+			stats.skips[detector::id]++;
+			return;
+		}
+
+		d.detect(img, result);
+		stats.runs[detector::id]++;
+		ran++;
+
+		// the last detector has nothing left to skip
+		if (stage + 1 == size())
+			return;
+
+		confident = true;
+		for (int c = 0; c < result.get_num_categories() && confident; c++)
+		{
+			confident = confidence(img, result, c, stage + 1, params, scratch) >= params.threshold;
+		}
+	}
+
+	void fuse_prefix(const Mat &img, const frame_result &result, int category, size_t stages_run, weighted_points &fused) const
+	{
+		fused.clear();
+		size_t stage = 0;
+		apply([&](const auto &...d)
+			  { ((stage++ < stages_run ? fuse_detector(d, img, result, category, fused) : void()), ...); },
+			  stages);
+	}
+
+	template <typename detector>
+	static bool agrees(const detector &d, const Mat &img, const frame_result &result, int category, const Rect &box)
+	{
+		for (const Point &pt : d.fused_points(result, category))
+		{
+			if (d.accept_point(img, category, pt) && box.contains(pt))
+				return true;
+		}
+		return false;
+	}
+
+	template <typename detector>
+	static void fuse_detector(const detector &d, const Mat &img, const frame_result &result, int category, weighted_points &fused)
+	{
+		point_view points = d.fused_points(result, category);
+		auto accepted = [&](size_t i)
+		{ return d.accept_point(img, category, points[i]); };
+		fuse_block(points, static_cast<float>(d.get_weight()), accepted, fused);
+	}
+
+	template <typename detector>
+	static void check_detector_colors(const detector &d, const Mat &img, const frame_result &result, int category, detector_id id, vector<uint8_t> &accepted)
+	{
+		if (detector::id != id)
+			return;
+		point_view points = result.view(id, category);
+		for (size_t i = 0; i < points.size(); i++)
+			accepted.push_back(d.accept_point(img, category, points[i]) ? 1 : 0);
+	}
+};
+
+#endif // DETECTION_PIPELINE_HPP
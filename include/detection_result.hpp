@@ -0,0 +1,172 @@
+// created by Davide Baggio 2122547
+
+#ifndef DETECTION_RESULT_HPP
+#define DETECTION_RESULT_HPP
+
+#include <vector>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+/*
+ * Detectors that can contribute points to a frame result.
+ */
+enum detector_id
+{
+	DETECTOR_HAAR = 0,
+	DETECTOR_ORB,
+	DETECTOR_SIFT,
+	DETECTOR_COUNT
+};
+
+/*
+ * Non-owning view over a contiguous range of points and their match distances.
+ *
+ * The view is invalidated when the `frame_result` it comes from is cleared or written again.
+ * `distances` may be null for views built from plain point vectors.
+ */
+struct point_view
+{
+	const Point *points = nullptr;
+	const float *distances = nullptr;
+	size_t count = 0;
+
+	point_view() {}
+	point_view(const Point *points, const float *distances, size_t count) : points(points), distances(distances), count(count) {}
+	point_view(const vector<Point> &points) : points(points.data()), count(points.size()) {}
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	const Point *begin() const { return points; }
+	const Point *end() const { return points + count; }
+	const Point &operator[](size_t i) const { return points[i]; }
+	float distance(size_t i) const { return distances ? distances[i] : 0.0f; }
+
+	/*
+	 * Returns the prefix holding the first `perc` fraction of the points.
+	 *
+	 * Parameters:
+	 * - perc: Fraction between 0 and 1, values outside the range are clamped.
+	 *
+	 * Behavior:
+	 * - Detectors store their points sorted by match distance, so the prefix holds the best matches.
+	 */
+	point_view top(float perc) const
+	{
+		perc = perc < 0.0f ? 0.0f : (perc > 1.0f ? 1.0f : perc);
+		return point_view(points, distances, static_cast<size_t>(count * perc));
+	}
+};
+
+/*
+ * Points found in a single frame by all detectors, stored as one structure-of-arrays buffer.
+ *
+ * Each detector writes one contiguous block per category, the block is then accessed
+ * through a `point_view` without copying. Clearing keeps the capacity, so a result reused
+ * across frames stops allocating once it has seen the largest frame.
+ */
+class frame_result
+{
+private:
+	struct block
+	{
+		uint32_t offset = 0;
+		uint32_t count = 0;
+	};
+
+	int num_categories;
+
+	// structure-of-arrays point buffer
+	vector<Point> points;
+	vector<float> distances;
+	vector<uint16_t> categories;
+	vector<uint8_t> sources;
+
+	// one block per (detector, category), indexed by detector * num_categories + category
+	vector<block> blocks;
+
+	// block being written, -1 when none
+	int open_block = -1;
+
+	// candidate regions of the frame proposed by a detector for the following ones
+	vector<Rect> regions;
+
+public:
+	/*
+	 * Parameters:
+	 * - num_categories: Number of model categories, as listed by the category table.
+	 */
+	frame_result(int num_categories);
+
+	/*
+	 * Removes every point and block, keeping the allocated capacity.
+	 */
+	void clear();
+
+	/*
+	 * Reserves room for `n` points in every column of the buffer.
+	 */
+	void reserve(size_t n);
+
+	/*
+	 * Starts the block of points of `detector` for `category`.
+	 *
+	 * Behavior:
+	 * - Any previous content of the block in this frame is discarded (the view points to the new block).
+	 * - Prints an error and ignores the call if the indices are invalid.
+	 */
+	void begin_block(detector_id detector, int category);
+
+	/*
+	 * Appends a point to the open block.
+	 *
+	 * Parameters:
+	 * - pt: Point in image coordinates.
+	 * - distance: Match distance of the point, 0 for detectors without a distance.
+	 */
+	void push(const Point &pt, float distance);
+
+	/*
+	 * Closes the open block.
+	 */
+	void end_block();
+
+	/*
+	 * Returns the points of `detector` for `category`, an empty view if none were written.
+	 */
+	point_view view(detector_id detector, int category) const;
+
+	/*
+	 * Returns the first `perc` fraction of the points of `detector` for `category`.
+	 */
+	point_view top(detector_id detector, int category, float perc) const;
+
+	/*
+	 * Scales every point and region by `factor`, mapping a result computed on a resized frame
+	 * back to the coordinates of the original frame.
+	 */
+	void rescale(float factor);
+
+	/*
+	 * Returns the candidate regions of the frame, written by a proposing detector (HAAR)
+	 * and read by the detectors that run after it.
+	 */
+	vector<Rect> &get_regions();
+	const vector<Rect> &get_regions() const;
+
+	// Total number of points stored in the frame
+	size_t size() const;
+
+	// Number of categories the result was created for
+	int get_num_categories() const;
+
+	// Columns of the buffer, indexed by the same position
+	const vector<Point> &get_points() const;
+	const vector<float> &get_distances() const;
+	const vector<uint16_t> &get_categories() const;
+	const vector<uint8_t> &get_sources() const;
+};
+
+#endif // DETECTION_RESULT_HPP
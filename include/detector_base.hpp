@@ -0,0 +1,172 @@
+// created by Davide Baggio 2122547
+
+#ifndef DETECTOR_BASE_HPP
+#define DETECTOR_BASE_HPP
+
+#include <opencv2/opencv.hpp>
+#include "detection_result.hpp"
+#include "category_tasks.hpp"
+
+using namespace std;
+using namespace cv;
+
+/*
+ * Static interface shared by every detector of the pipeline (CRTP).
+ *
+ * Template Parameters:
+ * - derived: The detector class, which must provide:
+ *   - `static constexpr detector_id id`, the block its points are written to.
+ *   - `void compute_detection(const Mat &img, frame_result &result)`.
+ *   - `void display_points(const frame_result &result)`.
+ *   It may also hide `accept_point` to down-weight its points during the fusion, and set
+ *   `supports_regions` if it can restrict its work to the regions of the frame result.
+ *
+ * Behavior:
+ * - Calls are resolved at compile time, no virtual dispatch is involved.
+ * - Holds the fusion parameters of the detector: the fraction of best points that is used and
+ *   the weight each of them has in the clustering.
+ */
+template <typename derived>
+class detector_base
+{
+protected:
+	// fraction of the best points of each category used by the fusion
+	float fraction = 1.0f;
+
+	// weight of each of the used points in the clustering
+	double weight = 1.0;
+
+	// restrict the work to the regions of the frame result, for detectors that support it
+	bool use_regions = false;
+
+	// process the categories of a frame as parallel tasks, for detectors with per-category work
+	bool parallel_categories = true;
+
+	// match the model views of all the categories as parallel tasks, for detectors that match views
+	bool parallel_views = true;
+
+	// process frames larger than a tile as overlapping tiles of this size plus the halo, 0 processes the whole frame
+	int tile_size = 0;
+	int tile_halo = 0;
+
+	// print a line per frame and per category without matches, off when the pipeline is embedded
+	bool log_frames = true;
+
+public:
+	// true for detectors that honour `use_regions`
+	static constexpr bool supports_regions = false;
+
+	/*
+	 * Runs the detector on `img` and writes its points into `result`.
+	 */
+	void detect(const Mat &img, frame_result &result)
+	{
+		static_cast<derived *>(this)->compute_detection(img, result);
+	}
+
+	/*
+	 * Displays the points written by the detector in `result`.
+	 */
+	void display(const frame_result &result)
+	{
+		static_cast<derived *>(this)->display_points(result);
+	}
+
+	/*
+	 * Returns the points of `category` used by the fusion, the best `fraction` of them.
+	 */
+	point_view fused_points(const frame_result &result, int category) const
+	{
+		return result.top(derived::id, category, fraction);
+	}
+
+	/*
+	 * Returns true if the point agrees with the colors of its category, every point does by default.
+	 * Rejected points keep a reduced weight in the fusion.
+	 *
+	 * Parameters:
+	 * - img: The frame the point was detected in.
+	 * - category: Category of the point.
+	 * - pt: The point.
+	 */
+	bool accept_point(const Mat &img, int category, const Point &pt) const
+	{
+		return true;
+	}
+
+	/*
+	 * Sets the fusion parameters of the detector.
+	 *
+	 * Parameters:
+	 * - fraction: Fraction (0 to 1) of the best points used for each category.
+	 * - weight: Weight (0 to 1) of each used point, a point of weight 1 counts as one point in the clustering.
+	 */
+	void set_fusion(float fraction, double weight)
+	{
+		this->fraction = fraction;
+		this->weight = weight;
+	}
+
+	/*
+	 * Enables the extraction of features only inside the regions of the frame result
+	 * (ignored by detectors that do not support regions).
+	 */
+	void set_use_regions(bool enable)
+	{
+		use_regions = enable;
+	}
+
+	bool get_use_regions() const
+	{
+		return use_regions;
+	}
+
+	/*
+	 * Enables the processing of the categories of a frame as parallel tasks (see `run_category_tasks`).
+	 */
+	void set_parallel_categories(bool enable)
+	{
+		parallel_categories = enable;
+	}
+
+	/*
+	 * Enables the matching of every model view as a parallel task (see `view_search`).
+	 */
+	void set_parallel_views(bool enable)
+	{
+		parallel_views = enable;
+	}
+
+	/*
+	 * Enables the tiled processing of large frames (see `make_tiles`).
+	 *
+	 * Parameters:
+	 * - size: Largest side of the part of the frame a tile owns, 0 processes the whole frame.
+	 * - halo: Pixels processed around the part a tile owns, so the features near its border are complete.
+	 */
+	void set_tiling(int size, int halo)
+	{
+		tile_size = size;
+		tile_halo = halo;
+	}
+
+	/*
+	 * Enables the lines printed for every frame, such as the categories without matches.
+	 */
+	void set_frame_log(bool enable)
+	{
+		log_frames = enable;
+	}
+
+	float get_fraction() const
+	{
+		return fraction;
+	}
+
+	double get_weight() const
+	{
+		return weight;
+	}
+};
+
+#endif // DETECTOR_BASE_HPP
@@ -0,0 +1,99 @@
+// created by Davide Baggio 2122547
+
+#ifndef FEATURE_BUDGET_HPP
+#define FEATURE_BUDGET_HPP
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+/*
+ * Controller that bounds the number of keypoints a feature detector keeps in each frame.
+ *
+ * The limit comes from two sources:
+ * - Time: the cost of a frame is modelled as a fixed detection cost plus a cost per kept keypoint
+ *   (descriptor extraction and matching), both tracked as moving averages of the measured times.
+ *   The time limit is the number of keypoints that fits in the per-frame budget.
+ * - Content: only keypoints with a response of at least `response_ratio` times the strongest one are kept,
+ *   so weak responses of low-texture frames are not described at all.
+ */
+class feature_budget
+{
+private:
+	// time budget of a frame in seconds, 0 disables the controller
+	double budget = 0.0;
+
+	// bounds of the number of kept keypoints
+	int min_keypoints = 50;
+	int max_keypoints = 2000;
+
+	// minimum response, relative to the strongest keypoint, of a kept keypoint
+	float response_ratio = 0.1f;
+
+	// moving averages of the detection time and of the time per kept keypoint, in seconds
+	double detection_cost = 0.0;
+	double keypoint_cost = 0.0;
+	bool calibrated = false;
+
+	// detection time of the current frame, in seconds
+	double last_detection = 0.0;
+
+	// weight of the newest measure in the moving averages
+	double smoothing = 0.2;
+
+	// statistics
+	size_t frames = 0;
+	size_t detected_total = 0;
+	size_t kept_total = 0;
+
+public:
+	/*
+	 * Parameters:
+	 * - budget_ms: Time budget of a frame in milliseconds, 0 disables the controller.
+	 * - max_keypoints: Maximum number of keypoints kept in a frame.
+	 */
+	feature_budget(double budget_ms = 0.0, int max_keypoints = 2000);
+
+	/*
+	 * Returns true if the controller limits the keypoints.
+	 */
+	bool enabled() const;
+
+	/*
+	 * Returns the number of keypoints that fits in the time budget given the measured costs,
+	 * `max_keypoints` until the first frame is measured.
+	 */
+	int limit() const;
+
+	/*
+	 * Keeps only the strongest keypoints allowed by the time and content limits.
+	 *
+	 * Parameters:
+	 * - keypoints: Detected keypoints, reduced in place to the retained ones.
+	 */
+	void select(vector<KeyPoint> &keypoints);
+
+	/*
+	 * Records the time spent detecting the keypoints of a frame.
+	 */
+	void record_detection(double seconds);
+
+	/*
+	 * Records the total time spent on a frame, the time not spent detecting is charged to its kept keypoints
+	 * (descriptors and matching).
+	 *
+	 * Parameters:
+	 * - keypoints: Number of keypoints kept in the frame.
+	 * - seconds: Total time of the frame, detection included.
+	 */
+	void record_frame(size_t keypoints, double seconds);
+
+	/*
+	 * Prints the average number of detected and kept keypoints per frame and the current limit.
+	 */
+	void print_stats(const string &name, ostream &out) const;
+};
+
+#endif // FEATURE_BUDGET_HPP
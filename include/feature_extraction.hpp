@@ -0,0 +1,107 @@
+// created by Davide Baggio 2122547
+
+#ifndef FEATURE_EXTRACTION_HPP
+#define FEATURE_EXTRACTION_HPP
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "opencv2/features2d.hpp"
+#include "feature_budget.hpp"
+
+using namespace std;
+using namespace cv;
+
+// fraction of the frame above which the regions are not worth cropping and the full frame is used
+const static float max_region_coverage = 0.8f;
+
+/*
+ * Expands candidate regions, clips them to the frame and merges the overlapping ones.
+ *
+ * Parameters:
+ * - regions: Candidate regions, replaced by the merged ones.
+ * - frame: Size of the frame the regions belong to.
+ * - expand: Fraction of its width and height added on each side of every region.
+ *
+ * Behavior:
+ * - Overlapping regions are replaced by their bounding rectangle until no two regions overlap.
+ * - Empty regions after clipping are removed.
+ */
+void merge_regions(vector<Rect> &regions, Size frame, float expand);
+
+/*
+ * Returns the fraction of the frame covered by non-overlapping regions.
+ */
+float region_coverage(const vector<Rect> &regions, Size frame);
+
+/*
+ * Detects keypoints and computes their descriptors only inside the given regions.
+ *
+ * Parameters:
+ * - detector: Feature detector and extractor (ORB, SIFT).
+ * - img: Full frame.
+ * - regions: Non-overlapping regions of the frame, as produced by `merge_regions`.
+ * - keypoints: Output keypoints, in full frame coordinates.
+ * - descriptors: Output descriptors, one row per keypoint.
+ * - budget: Optional feature budget, the keypoints of all regions are reduced to its limit
+ *   before any descriptor is computed.
+ *
+ * Behavior:
+ * - If `regions` is empty or covers most of the frame, the whole frame is processed.
+ * - Otherwise each region is cropped (without copying), processed on its own and its keypoints are
+ *   shifted back by the region origin.
+ */
+void detect_in_regions(Feature2D &detector, const Mat &img, const vector<Rect> &regions, vector<KeyPoint> &keypoints, Mat &descriptors, feature_budget *budget = nullptr);
+
+/*
+ * Tile of a frame processed on its own. The tiles own disjoint parts of the frame, each is processed with a
+ * halo around its part so the features near its border have their full context.
+ */
+struct frame_tile
+{
+	// part of the frame the tile owns, the cores of all the tiles partition the frame
+	Rect core;
+	// core expanded by the halo on each side and clipped to the frame, the part actually processed
+	Rect area;
+};
+
+/*
+ * Splits a frame into overlapping tiles.
+ *
+ * Parameters:
+ * - frame: Size of the frame.
+ * - tile_size: Largest width and height of the core of a tile.
+ * - halo: Pixels added on each side of the core.
+ * - tiles: Output tiles, in row-major order.
+ *
+ * Behavior:
+ * - The cores are as even as possible, a frame no larger than a tile gives a single tile covering it.
+ */
+void make_tiles(Size frame, int tile_size, int halo, vector<frame_tile> &tiles);
+
+/*
+ * Returns true if a point belongs to the core of a tile.
+ */
+bool tile_owns(const frame_tile &tile, const Point2f &pt);
+
+/*
+ * Detects keypoints and computes their descriptors tile by tile, the tiles running as parallel tasks.
+ *
+ * Parameters:
+ * - detector: Feature detector and extractor (ORB, SIFT), used by all the tiles at once, which is safe as
+ *   long as the detector keeps no state between calls.
+ * - img: Full frame.
+ * - tiles: Tiles of the frame, as produced by `make_tiles`.
+ * - keypoints: Output keypoints, in full frame coordinates.
+ * - descriptors: Output descriptors, one row per keypoint.
+ * - budget: Optional feature budget, applied to the keypoints of all the tiles before any descriptor is computed.
+ *
+ * Behavior:
+ * - Each tile detects on its area and keeps only the keypoints of its core, so a keypoint found in the halo
+ *   of two tiles is kept once, by the tile that owns it.
+ * - The descriptors are computed on the area of the tile, so the halo gives them their context.
+ * - Keypoints and descriptors are gathered in tile order, the output does not depend on the number of threads.
+ * - A single tile processes the whole frame as `detect_in_regions` does.
+ */
+void detect_in_tiles(Feature2D &detector, const Mat &img, const vector<frame_tile> &tiles, vector<KeyPoint> &keypoints, Mat &descriptors, feature_budget *budget = nullptr);
+
+#endif // FEATURE_EXTRACTION_HPP
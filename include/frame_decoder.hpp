@@ -0,0 +1,70 @@
+// created by Davide Baggio 2122547
+
+#ifndef FRAME_DECODER_HPP
+#define FRAME_DECODER_HPP
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+/*
+ * Decodes the frames at the lowest resolution the processing needs.
+ *
+ * The reduction is chosen once from the processing scale: the largest of 8, 4 and 2 whose resolution is still
+ * at least the processing one, decoded by the JPEG decoder itself (IMREAD_REDUCED_COLOR_*, scaling in the DCT
+ * domain), so decoding time and frame memory shrink with the scale. Above half resolution frames are decoded
+ * in full.
+ *
+ * The file buffer and the decoded frame are reused across frames, so their memory is allocated only when a
+ * frame is larger than all the previous ones. When a dataset pack is open the frames are read from it: encoded
+ * frames are decoded straight from the mapping, raw frames are only reduced.
+ */
+class frame_decoder
+{
+private:
+	// reduction of each side of the frame (1, 2, 4 or 8) and matching imread flag
+	int reduction = 1;
+	int flags = IMREAD_COLOR;
+
+	// encoded file and decoded frame, reused across frames
+	vector<uchar> buffer;
+	Mat frame;
+
+public:
+	/*
+	 * Parameters:
+	 * - scale: Processing scale as a fraction of the native resolution (0 < scale <= 1).
+	 */
+	frame_decoder(float scale = 1.0f);
+
+	/*
+	 * Decodes an image file.
+	 *
+	 * Returns:
+	 * - The decoded BGR frame, valid until the next call (empty if the file cannot be read or decoded).
+	 */
+	Mat &decode(const string &path);
+
+	/*
+	 * Decodes an image encoded in memory, such as the content of a JPEG file.
+	 *
+	 * Returns:
+	 * - The decoded BGR frame, valid until the next call (empty if the buffer cannot be decoded).
+	 */
+	Mat &decode_buffer(const uchar *data, size_t size);
+
+	/*
+	 * Returns the scale of the decoded frames with respect to the native resolution (1, 1/2, 1/4 or 1/8).
+	 */
+	float get_scale() const;
+
+	/*
+	 * Maps a rectangle of a decoded frame to native coordinates.
+	 */
+	Rect to_native(const Rect &r) const;
+};
+
+#endif // FRAME_DECODER_HPP
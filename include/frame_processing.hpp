@@ -0,0 +1,166 @@
+// created by Davide Baggio 2122547
+
+#ifndef FRAME_PROCESSING_HPP
+#define FRAME_PROCESSING_HPP
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "haar_detector.hpp"
+#include "orb_detector.hpp"
+#include "sift_detector.hpp"
+#include "detection_pipeline.hpp"
+#include "feature_extraction.hpp"
+#include "dbscan.hpp"
+#include "memory_tracker.hpp"
+#include "pipeline_config.hpp"
+#include "frame_decoder.hpp"
+#include "category_tasks.hpp"
+
+using namespace std;
+using namespace cv;
+
+/*
+ * Buffers and parameters used to process a frame, reused across frames so their capacity is allocated only once.
+ */
+struct frame_context
+{
+	// points of the detectors on the processed frame and of the full resolution refinement
+	frame_result result;
+	frame_result refined;
+
+	// fused points of each category and scratch buffer of the adaptive confidence check
+	vector<weighted_points> fused;
+	weighted_points scratch;
+
+	// frame resized to the processing resolution
+	Mat scaled;
+
+	// DBSCAN parameters of the final clustering, min_points is the weight a core neighbourhood must reach
+	float eps = 55.0f;
+	int min_points = 3;
+
+	cascade_params adaptive;
+	cascade_stats adaptive_stats;
+
+	frame_context(int num_categories, const pipeline_config &config) : result(num_categories), refined(num_categories), fused(num_categories)
+	{
+		adaptive.threshold = config.cascade_threshold;
+		adaptive.target_points = config.cascade_target_points;
+		adaptive.eps = eps;
+		adaptive.min_points = min_points;
+	}
+};
+
+/*
+ * Detects the box of every category in a frame.
+ *
+ * Parameters:
+ * - pipeline: The detection pipeline.
+ * - img: The frame at its native resolution.
+ * - config: Runtime options (processing scale, refinement, adaptive mode).
+ * - ctx: Buffers and parameters of the processing.
+ * - boxes: Output box of each category, in native frame coordinates.
+ *
+ * Behavior:
+ * - If the processing scale is below 1, the detectors run on a downscaled copy of the frame and
+ *   every point and region is mapped back to native coordinates before the fusion and clustering.
+ * - If refinement is enabled, the detectors that support regions run again at native resolution
+ *   inside the boxes found, expanded by `refine_expand`, and a non-empty refined cluster replaces the box.
+ * - The fusion and clustering of the categories run as parallel tasks unless disabled in the config.
+ */
+template <typename pipeline_type>
+void detect_frame(pipeline_type &pipeline, const Mat &img, const pipeline_config &config, frame_context &ctx, vector<Rect> &boxes)
+{
+	const Mat *input = &img;
+	if (config.scale < 1.0f)
+	{
+		resize(img, ctx.scaled, Size(), config.scale, config.scale, INTER_AREA);
+		input = &ctx.scaled;
+	}
+
+	ctx.result.clear();
+	if (config.cascade)
+	{
+		// the confidence check clusters on the processed frame, so its radius follows the scale
+		cascade_params adaptive = ctx.adaptive;
+		adaptive.eps *= static_cast<float>(input->cols) / static_cast<float>(img.cols);
+		pipeline.detect_adaptive(*input, ctx.result, adaptive, ctx.adaptive_stats, ctx.scratch);
+	}
+	else
+		pipeline.detect(*input, ctx.result);
+	// pipeline.display(ctx.result);
+
+	if (input != &img)
+		ctx.result.rescale(static_cast<float>(img.cols) / static_cast<float>(input->cols));
+
+	// every category fuses and clusters into its own buffers, reading the frame result shared by all
+	int num_categories = ctx.result.get_num_categories();
+	auto cluster_category = [&](int c)
+	{
+		mem_scope fusion_scope(STAGE_FUSION, c);
+		pipeline.fuse(img, ctx.result, c, ctx.fused[c]);
+
+		mem_scope clustering_scope(STAGE_CLUSTERING);
+		boxes[c] = get_dense_cluster(ctx.fused[c], ctx.eps, static_cast<float>(ctx.min_points));
+	};
+	run_category_tasks(num_categories, config.parallel_categories, cluster_category);
+
+	if (!config.refine || input == &img)
+		return;
+
+	ctx.refined.clear();
+	for (int c = 0; c < num_categories; c++)
+	{
+		if (!boxes[c].empty())
+			ctx.refined.get_regions().push_back(boxes[c]);
+	}
+	if (ctx.refined.get_regions().empty())
+		return;
+	merge_regions(ctx.refined.get_regions(), img.size(), config.refine_expand);
+
+	pipeline.detect_regions(img, ctx.refined);
+	auto refine_category = [&](int c)
+	{
+		if (boxes[c].empty())
+			return;
+		mem_scope fusion_scope(STAGE_FUSION, c);
+		pipeline.fuse(img, ctx.refined, c, ctx.fused[c]);
+
+		mem_scope clustering_scope(STAGE_CLUSTERING);
+		Rect refined = get_dense_cluster(ctx.fused[c], ctx.eps, static_cast<float>(ctx.min_points));
+		if (!refined.empty())
+			boxes[c] = refined;
+	};
+	run_category_tasks(num_categories, config.parallel_categories, refine_category);
+}
+
+/*
+ * Returns the decoder of the frames for a processing scale and the scale left to the detectors after the decode.
+ *
+ * Behavior:
+ * - Frames are decoded in full if requested or if the boxes are refined at native resolution.
+ */
+frame_decoder make_decoder(const pipeline_config &config, float &residual_scale);
+
+/*
+ * Detectors of the pipeline, run in this order.
+ */
+struct detector_set
+{
+	haar_detector cascade;
+	orb_detector orb;
+	sift_detector sift;
+	detection_pipeline<haar_detector, orb_detector, sift_detector> pipeline;
+
+	detector_set() : pipeline(cascade, orb, sift) {}
+};
+
+/*
+ * Applies the runtime options to freshly loaded detectors.
+ *
+ * Returns:
+ * - False if a cascade of the detectors or a requested one cannot be loaded.
+ */
+bool configure_detectors(const pipeline_config &config, detector_set &detectors);
+
+#endif // FRAME_PROCESSING_HPP
@@ -0,0 +1,168 @@
+// created by Davide Baggio 2122547
+
+#ifndef FUSION_CACHE_HPP
+#define FUSION_CACHE_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "detection_pipeline.hpp"
+#include "detection.hpp"
+
+using namespace std;
+using namespace cv;
+
+/*
+ * Parameters of the fusion and of the final clustering, the ones a sweep tunes.
+ */
+struct fusion_setting
+{
+	// fraction of the best points used and weight of each of them, indexed by detector id
+	float fractions[DETECTOR_COUNT] = {1.0f, 0.4f, 0.3f};
+	float weights[DETECTOR_COUNT] = {0.5f, 1.0f, 0.5f};
+
+	// DBSCAN radius and weight a core neighbourhood must reach
+	float eps = 55.0f;
+	float min_weight = 3.0f;
+};
+
+/*
+ * Outputs of the detectors on a frame, as needed to fuse it again with any setting.
+ */
+struct cached_frame
+{
+	// name of the frame and ground truth boxes by class name
+	string name;
+	map<string, Rect> labels;
+
+	// false for a frame that could not be decoded, kept with empty blocks and left out of the scores
+	bool decoded = true;
+
+	// every point of every (detector, category) block in native frame coordinates, with its match distance
+	// and the color check of its detector, blocks indexed by detector * num_categories + category
+	vector<Point> points;
+	vector<float> distances;
+	vector<uint8_t> accepted;
+	vector<uint32_t> offsets;
+	vector<uint32_t> counts;
+};
+
+/*
+ * Cache of the detector outputs of a set of frames, so the fusion and clustering can be evaluated for many
+ * settings without running the detectors again.
+ *
+ * Blocks are stored in full, sorted by distance as the detectors write them, so any fraction of them can be
+ * used. The color checks depend on the frame colors and are stored per point, which lets the frames be
+ * dropped once recorded.
+ *
+ * The file is keyed on the inputs of the detectors, the scale they run at and the categories, so a cache
+ * written with other inputs is not read back.
+ */
+class fusion_cache
+{
+private:
+	vector<string> category_names;
+	int num_categories;
+	float scale;
+	vector<cached_frame> frames;
+
+public:
+	/*
+	 * Parameters:
+	 * - category_names: Class name of each category of the frame results.
+	 * - scale: Scale the detectors run at.
+	 */
+	fusion_cache(const vector<string> &category_names, float scale);
+
+	/*
+	 * Records the outputs of the detectors on a frame.
+	 *
+	 * Parameters:
+	 * - pipeline: The pipeline that filled the result, it runs the color checks.
+	 * - name: Name of the frame.
+	 * - labels: Ground truth boxes of the frame, by class name.
+	 * - img: The frame at native resolution.
+	 * - result: Points of the detectors, in native coordinates.
+	 */
+	template <typename pipeline_type>
+	void add(const pipeline_type &pipeline, const string &name, const map<string, Rect> &labels, const Mat &img, const frame_result &result)
+	{
+		frames.emplace_back();
+		cached_frame &frame = frames.back();
+		frame.name = name;
+		frame.labels = labels;
+
+		vector<uint8_t> accepted;
+		for (int d = 0; d < DETECTOR_COUNT; d++)
+		{
+			for (int c = 0; c < num_categories; c++)
+			{
+				point_view points = result.view(static_cast<detector_id>(d), c);
+				pipeline.check_colors(img, result, c, static_cast<detector_id>(d), accepted);
+				accepted.resize(points.size(), 1);
+
+				frame.offsets.push_back(static_cast<uint32_t>(frame.points.size()));
+				frame.counts.push_back(static_cast<uint32_t>(points.size()));
+				for (size_t i = 0; i < points.size(); i++)
+				{
+					frame.points.push_back(points[i]);
+					frame.distances.push_back(points.distance(i));
+				}
+				frame.accepted.insert(frame.accepted.end(), accepted.begin(), accepted.end());
+			}
+		}
+	}
+
+	/*
+	 * Records a frame that could not be decoded, so the cache still holds every frame it was built on.
+	 */
+	void add_failed(const string &name);
+
+	/*
+	 * Writes the cache to a binary file.
+	 *
+	 * Returns:
+	 * - False if the file cannot be written.
+	 */
+	bool save(const string &path) const;
+
+	/*
+	 * Reads a cache written by `save`.
+	 *
+	 * Returns:
+	 * - False if the file cannot be read or was written with another scale or other categories.
+	 */
+	bool load(const string &path);
+
+	/*
+	 * Returns true if the cache holds exactly the given frames, in the same order.
+	 */
+	bool matches(const vector<string> &names) const;
+
+	/*
+	 * Fuses the points of a cached frame for a category, as `detection_pipeline::fuse` does on the live result.
+	 *
+	 * Behavior:
+	 * - The detectors are fused in id order, the order of the pipeline.
+	 */
+	void fuse(size_t frame, int category, const fusion_setting &setting, weighted_points &fused) const;
+
+	/*
+	 * Fuses and clusters every cached frame with a setting and scores the boxes against the labels.
+	 *
+	 * Parameters:
+	 * - setting: Fusion and clustering parameters.
+	 * - names: Class name of each category, as used in the labels.
+	 * - scratch: Reusable buffer for the fused points, one per concurrent evaluation.
+	 *
+	 * Returns:
+	 * - The IoU and detection counts over all the decoded frames.
+	 */
+	detection_score evaluate(const fusion_setting &setting, const vector<string> &names, weighted_points &scratch) const;
+
+	// Number of cached frames that could be decoded
+	size_t size() const;
+};
+
+#endif // FUSION_CACHE_HPP
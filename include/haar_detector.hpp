@@ -7,74 +7,150 @@
 #include <vector>
 #include <opencv2/opencv.hpp>
 #include "detection.hpp"
+#include "detection_result.hpp"
+#include "detector_base.hpp"
+#include "feature_extraction.hpp"
 
 using namespace std;
 using namespace cv;
 
-class haar_detector
+class haar_detector : public detector_base<haar_detector>
 {
 private:
 	Mat test;
 
-	CascadeClassifier cascade_sugar;
-	CascadeClassifier cascade_mustard;
-	CascadeClassifier cascade_drill;
+	// cascade of each category of the category table and the features it was trained on
+	vector<CascadeClassifier> cascades;
+	vector<cascade_type> types;
 
-	vector<vector<Point>> points = vector<vector<Point>>(3);
+	// false if a cascade of the category table could not be loaded
+	bool loaded = true;
+
+	// detections of each category, detections of the current tile, tiles, gray frame and display copies of
+	// the last frame, reused across frames
+	vector<vector<Rect>> objects;
+	vector<vector<Rect>> tile_objects;
+	vector<frame_tile> tiles;
+	Mat gray;
+	vector<Mat> display_frames;
+
+	// fraction by which the detections are expanded into region proposals, 0 disables the proposals
+	float proposal_expand = 0.0f;
 
 public:
+	// block of the frame result the detector writes to
+	static constexpr detector_id id = DETECTOR_HAAR;
+
 	/*
 	 * Constructor for the `haar_detector` class.
 	 *
-	 * Loads Haar cascade classifiers for sugar boxes, mustard bottles, and power drills.
+	 * Loads the Haar cascade classifier of every category of the category table.
 	 *
-	 * If any cascade file fails to load, an error is printed and the program exits.
+	 * If any cascade file fails to load, an error is printed and `is_loaded` returns false.
 	 */
 	haar_detector();
 
 	/*
-	 * Sets or updates the detected points for a specific category index.
+	 * Returns false if a cascade of the category table could not be loaded, the detector must not be used.
+	 */
+	bool is_loaded() const;
+
+	/*
+	 * Performs object detection on the given image using Haar cascade classifiers.
 	 *
 	 * Parameters:
-	 * - points: Vector of points to set.
-	 * - index: Category index (0 for sugar, 1 for mustard, 2 for drill).
+	 * - img: Input image on which detection is performed.
+	 * - result: Frame result the detections are written to.
 	 *
 	 * Behavior:
-	 * - Validates the index before inserting.
-	 * - If the index is invalid, prints an error message.
+	 * - Converts the input image to grayscale and equalizes the histogram.
+	 * - Detects objects for each category.
+	 * - Writes the center points of detected bounding boxes into the HAAR block of each category, with distance 0.
+	 * - If proposals are enabled, writes the detected boxes of all categories, expanded and merged,
+	 *   as the regions of the frame result.
+	 * - If tiling is enabled and the frame is larger than a tile, every category scans the tiles in order and
+	 *   keeps the detections centered in the core of their tile, objects whose half size exceeds the halo can be
+	 *   missed. A classifier keeps the state of the image it scans, so only the categories run in parallel.
 	 */
-	void set_points(vector<Point> points, size_t index);
+	void compute_detection(const Mat &img, frame_result &result);
 
 	/*
-	 * Performs object detection on the given image using Haar cascade classifiers.
+	 * Displays detected points on separate copies of the input image.
 	 *
 	 * Parameters:
-	 * - img: Input image on which detection is performed.
+	 * - result: Frame result previously filled by `compute_detection`.
 	 *
 	 * Behavior:
-	 * - Converts the input image to grayscale and equalizes the histogram.
-	 * - Detects objects for each category (sugar, mustard, drill).
-	 * - Saves the center points of detected bounding boxes into the `points` array.
+	 * - Draws a green circle around each detected center point.
+	 * - Displays the results separately for each category.
+	 * - If no points are found for a category, prints a message and skips display.
 	 */
-	void compute_detection(Mat img);
+	void display_points(const frame_result &result);
 
 	/*
-	 * Retrieves the detected points for each object category.
+	 * Filters the points used by the fusion by the color of the frame under them.
 	 *
 	 * Returns:
-	 * - A vector of vectors containing points for each detected object category (sugar, mustard, drill).
+	 * - True if the pixel has one of the colors listed for the category (`colors.txt`, such as yellow and
+	 *   white for the sugar box), true for the categories without colors.
 	 */
-	vector<vector<Point>> get_points();
+	bool accept_point(const Mat &img, int category, const Point &pt) const;
 
 	/*
-	 * Displays detected points on separate copies of the input image.
+	 * Enables the region proposals written by `compute_detection`.
 	 *
-	 * Behavior:
-	 * - Draws a green circle around each detected center point.
-	 * - Displays the results separately for each category (sugar, mustard, drill).
-	 * - If no points are found for a category, prints a message and skips display.
+	 * Parameters:
+	 * - expand: Fraction of its width and height added on each side of every detection, 0 disables the proposals.
 	 */
-	void display_points();
+	void set_proposals(float expand);
+
+	/*
+	 * Replaces the cascade of a category with the one trained on other features.
+	 *
+	 * Parameters:
+	 * - category: Index of the category in the category table.
+	 * - type: Features of the cascade, loaded from `get_cascade_path`.
+	 *
+	 * Returns:
+	 * - False if the cascade cannot be loaded, the current one is kept.
+	 */
+	bool set_cascade_type(int category, cascade_type type);
+
+	cascade_type get_cascade_type(int category) const;
+};
+
+/*
+ * Latency and accuracy of a cascade on a set of test images.
+ */
+struct cascade_benchmark
+{
+	// time spent in the multi-scale detection and number of frames
+	double seconds = 0;
+	size_t frames = 0;
+
+	// IoU of the most confident detection on the frames labelled with the category
+	detection_score score;
+
+	// frames without the category where the cascade detected it
+	size_t false_detections = 0;
 };
 
+/*
+ * Runs the cascade of a category alone on a set of test images.
+ *
+ * Parameters:
+ * - category: Folder of the category, such as "004_sugar_box/".
+ * - type: Features of the cascade.
+ * - filenames: Test images, of any category.
+ * - result: Output, latency and accuracy of the cascade.
+ *
+ * Returns:
+ * - False if the cascade cannot be loaded.
+ *
+ * Behavior:
+ * - Frames are preprocessed as in `compute_detection`, only the detection is timed.
+ * - The box of a frame is the detection with the highest level weight.
+ */
+bool benchmark_cascade(const string &category, cascade_type type, const vector<String> &filenames, cascade_benchmark &result);
+
 #endif // HAAR_DETECTOR_HPP
\ No newline at end of file
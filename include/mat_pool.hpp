@@ -0,0 +1,93 @@
+// created by Davide Baggio 2122547
+
+#ifndef MAT_POOL_HPP
+#define MAT_POOL_HPP
+
+#include <atomic>
+#include <iostream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+// smallest buffer kept by the pool, smaller ones are cheap to allocate and mostly of one-off sizes
+const static size_t mat_pool_min_bytes = 256 << 10;
+
+// released buffers kept per byte size
+const static size_t mat_pool_max_per_size = 4;
+
+/*
+ * Mat allocator that recycles released buffers for later Mats of the same byte size.
+ *
+ * The frames of a run all have the same size, so the frame-sized buffers of each stage (gray and equalized
+ * frames, pyramids) are found in the pool from the second frame on and allocate no new memory. Only buffers
+ * of at least `mat_pool_min_bytes` are pooled: descriptor, keypoint and response Mats change their row count
+ * every frame and would fill the pool with sizes never asked for again. A size keeps at most
+ * `mat_pool_max_per_size` buffers, and a release that does not fit in the pool evicts the least recently
+ * released buffers first, so buffers of sizes no longer used are freed instead of pinned.
+ * Buffers are allocated by the parent allocator, so the pool composes with the tracking allocator, whose
+ * accounting keeps pooled buffers as live.
+ */
+class pooled_mat_allocator : public MatAllocator
+{
+private:
+	MatAllocator *parent;
+
+	// released buffers from the least to the most recently released, and the ones of each byte size in the
+	// same order, bounded by max_bytes in total
+	mutable mutex lock;
+	mutable list<UMatData *> released;
+	mutable map<size_t, vector<list<UMatData *>::iterator>> free_buffers;
+	mutable size_t pooled_bytes = 0;
+	size_t max_bytes;
+
+	// allocations requested and served from the pool, and buffers evicted
+	mutable atomic<size_t> requests{0};
+	mutable atomic<size_t> reused{0};
+	mutable atomic<size_t> evicted{0};
+
+	/*
+	 * Removes the least recently released buffer of a size from the pool and returns it, the lock must be held.
+	 */
+	UMatData *take_oldest(size_t size) const;
+
+public:
+	/*
+	 * Parameters:
+	 * - max_bytes: Maximum memory kept in the pool, released buffers beyond it are freed.
+	 * - parent: Allocator that performs the real allocation (default: the current OpenCV default allocator).
+	 */
+	pooled_mat_allocator(size_t max_bytes, MatAllocator *parent = nullptr);
+
+	UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step, AccessFlag flags, UMatUsageFlags usage_flags) const override;
+	bool allocate(UMatData *data, AccessFlag access_flags, UMatUsageFlags usage_flags) const override;
+	void deallocate(UMatData *data) const override;
+
+	/*
+	 * Prints the number of allocations, the fraction served from the pool, the evictions and the pooled memory.
+	 */
+	void print_stats(ostream &out) const;
+};
+
+/*
+ * Installs a pooled allocator as the OpenCV default allocator.
+ *
+ * Parameters:
+ * - max_bytes: Maximum memory kept in the pool.
+ *
+ * Behavior:
+ * - Must be called after `enable_mat_tracking`, if used, so the pooled buffers are still accounted for.
+ * - The allocator is never destroyed, Mats released at exit still go through it.
+ */
+void enable_mat_pool(size_t max_bytes);
+
+/*
+ * Prints the statistics of the installed pool, nothing if no pool is installed.
+ */
+void print_mat_pool_stats(ostream &out);
+
+#endif // MAT_POOL_HPP
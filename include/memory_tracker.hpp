@@ -0,0 +1,158 @@
+// created by Davide Baggio 2122547
+
+#ifndef MEMORY_TRACKER_HPP
+#define MEMORY_TRACKER_HPP
+
+#include <iostream>
+#include <atomic>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+/*
+ * Pipeline stages the allocations are attributed to.
+ */
+enum mem_stage
+{
+	STAGE_OTHER = 0,
+	STAGE_MODEL_LOADING,
+	STAGE_DECODE,
+	STAGE_HAAR,
+	STAGE_ORB,
+	STAGE_SIFT,
+	STAGE_FUSION,
+	STAGE_CLUSTERING,
+	STAGE_OUTPUT,
+	STAGE_COUNT
+};
+
+/*
+ * Source of an allocation: the global operator new/delete or the OpenCV Mat allocator.
+ */
+enum mem_source
+{
+	SOURCE_HEAP = 0,
+	SOURCE_MAT,
+	SOURCE_COUNT
+};
+
+// category slot used for allocations that are not bound to a model category
+const static int CATEGORY_NONE = -1;
+// number of category slots in the accounting table, the last one collects any overflow
+const static int MAX_TRACKED_CATEGORIES = 16;
+
+/*
+ * Counters of a single (source, stage, category) slot.
+ */
+struct mem_counters
+{
+	atomic<int64_t> live_bytes{0};
+	atomic<int64_t> peak_bytes{0};
+	atomic<int64_t> total_bytes{0};
+	atomic<int64_t> allocations{0};
+	atomic<int64_t> deallocations{0};
+};
+
+/*
+ * RAII guard that attributes every allocation made by the current thread to a stage and category.
+ *
+ * Parameters:
+ * - stage: Pipeline stage of the scope.
+ * - category: Model category index, or CATEGORY_NONE (default) to keep the category of the enclosing scope.
+ *
+ * Behavior:
+ * - Saves the current attribution and restores it when the scope is left, so scopes can be nested.
+ */
+class mem_scope
+{
+private:
+	int prev_stage;
+	int prev_category;
+
+public:
+	mem_scope(mem_stage stage, int category = CATEGORY_NONE);
+	~mem_scope();
+
+	mem_scope(const mem_scope &) = delete;
+	mem_scope &operator=(const mem_scope &) = delete;
+};
+
+/*
+ * Mat allocator that forwards to the OpenCV standard allocator and records every buffer
+ * in the accounting table of the stage and category active at allocation time.
+ */
+class tracking_mat_allocator : public MatAllocator
+{
+private:
+	MatAllocator *parent;
+
+public:
+	/*
+	 * Parameters:
+	 * - parent: Allocator that performs the real allocation (default: the OpenCV standard allocator).
+	 */
+	tracking_mat_allocator(MatAllocator *parent = nullptr);
+
+	UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step, AccessFlag flags, UMatUsageFlags usage_flags) const override;
+	bool allocate(UMatData *data, AccessFlag access_flags, UMatUsageFlags usage_flags) const override;
+	void deallocate(UMatData *data) const override;
+};
+
+/*
+ * Records an allocation of `bytes` from `source` in the slot of the current stage and category.
+ *
+ * Returns:
+ * - The slot index, to be passed back to `mem_record_free` when the memory is released.
+ */
+int mem_record_alloc(mem_source source, size_t bytes);
+
+/*
+ * Records the release of `bytes` from `source` previously allocated in `slot`.
+ */
+void mem_record_free(mem_source source, int slot, size_t bytes);
+
+/*
+ * Installs the tracking Mat allocator as the OpenCV default allocator.
+ *
+ * Behavior:
+ * - Must be called before any Mat that should be accounted for is created.
+ * - Buffers allocated before the call are released through their original allocator.
+ */
+void enable_mat_tracking();
+
+/*
+ * Returns true when the global operator new/delete are replaced by the tracking ones
+ * (the library was built with MEMORY_TRACKING).
+ */
+bool heap_tracking_enabled();
+
+/*
+ * Prints live bytes, peak bytes and allocation counts per source, stage and category.
+ *
+ * Parameters:
+ * - out: Stream the report is written to.
+ *
+ * Behavior:
+ * - Slots without any allocation are skipped.
+ * - Prints per-stage totals and the global peak of live bytes.
+ */
+void print_memory_report(ostream &out);
+
+/*
+ * Prints a single line with the current live bytes of every stage and the global peak.
+ */
+void print_memory_sample(ostream &out);
+
+/*
+ * Starts a background thread that prints a memory sample every `interval_ms` milliseconds.
+ */
+void start_memory_sampler(unsigned interval_ms, ostream &out);
+
+/*
+ * Stops the sampler thread started by `start_memory_sampler`, if any.
+ */
+void stop_memory_sampler();
+
+#endif // MEMORY_TRACKER_HPP
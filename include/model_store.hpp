@@ -0,0 +1,109 @@
+// created by Davide Baggio 2122547
+
+#ifndef MODEL_STORE_HPP
+#define MODEL_STORE_HPP
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+// alignment of the descriptor blocks, one cache line
+const static size_t model_store_alignment = 64;
+
+/*
+ * Contiguous store of the model descriptors of every category.
+ *
+ * The descriptors of all the views of a category are packed, in view order, into a single 64-byte aligned
+ * matrix, so matching a category walks one block of memory instead of one heap block per view.
+ *
+ * A side table gives the offset of the first row of each view of a category, the rows of view j are
+ * [offsets[j], offsets[j + 1]).
+ *
+ * The views are plain Mat headers over the blocks (`view`), used by the brute force matchers of the detectors
+ * as any other descriptor matrix. The blocks can be backed by huge pages to reduce the TLB misses of the
+ * matching.
+ */
+class model_store
+{
+private:
+	// aligned memory of a category
+	struct block
+	{
+		void *data = nullptr;
+		size_t bytes = 0;
+		bool mapped = false;
+		int slot = -1;
+	};
+
+	vector<block> blocks;
+	vector<Mat> category_descriptors;
+	vector<vector<int>> offsets;
+
+	// back the blocks by huge pages when the system provides them
+	bool huge_pages = false;
+	// at least one block is backed by huge pages
+	bool huge_pages_used = false;
+
+	/*
+	 * Allocates an aligned block of at least `bytes`, from huge pages if enabled and available.
+	 */
+	block allocate(size_t bytes);
+
+	/*
+	 * Releases a block returned by `allocate`.
+	 */
+	static void release(block &b);
+
+public:
+	model_store() = default;
+	model_store(const model_store &) = delete;
+	model_store &operator=(const model_store &) = delete;
+	~model_store();
+
+	/*
+	 * Enables huge pages for the blocks allocated by the next `pack`.
+	 */
+	void set_huge_pages(bool enable);
+
+	/*
+	 * Packs the descriptors of every view into the store.
+	 *
+	 * Parameters:
+	 * - views: Descriptors of each view of each category, replaced by headers into the store.
+	 *   They may already point into the store (e.g. to move it to huge pages).
+	 *
+	 * Behavior:
+	 * - All views of a category must share the descriptor type and length, empty views are allowed.
+	 * - The new blocks are filled before the old ones are released.
+	 * - Throws `bad_alloc` if a block cannot be allocated, the store keeps its previous blocks.
+	 */
+	void pack(vector<vector<Mat>> &views);
+
+	/*
+	 * Returns the number of categories.
+	 */
+	int num_categories() const;
+
+	/*
+	 * Returns the number of views of `category`.
+	 */
+	int num_views(int category) const;
+
+	/*
+	 * Returns the descriptors of a single view, a header into the category matrix.
+	 */
+	Mat view(int category, int view) const;
+	/*
+	 * Returns the total size of the descriptor blocks in bytes.
+	 */
+	size_t bytes() const;
+
+	/*
+	 * Returns true if at least one block is backed by huge pages.
+	 */
+	bool uses_huge_pages() const;
+};
+
+#endif // MODEL_STORE_HPP
@@ -0,0 +1,89 @@
+// created by Davide Baggio 2122547
+
+#ifndef NEGATIVE_MINING_HPP
+#define NEGATIVE_MINING_HPP
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "detection.hpp"
+
+using namespace std;
+using namespace cv;
+
+/*
+ * Returns the number of stages of a cascade, read from its XML text (0 if not found).
+ */
+int cascade_stage_count(const string &xml);
+
+/*
+ * Returns the XML text of a cascade reduced to its first `stages` stages.
+ *
+ * Behavior:
+ * - Relies on the `<!-- stage k -->` comments written by opencv_traincascade before each stage.
+ * - Returns an empty string if the stages cannot be located.
+ */
+string truncate_cascade(const string &xml, int stages);
+
+/*
+ * Loads a cascade from its XML text.
+ *
+ * Returns:
+ * - False if the text is not a valid cascade.
+ */
+bool load_cascade_from_memory(CascadeClassifier &classifier, const string &xml);
+
+/*
+ * Returns the number of windows scanned by `detectMultiScale` on an image, for a given window size and scale factor.
+ *
+ * Behavior:
+ * - Follows the scan of OpenCV with CASCADE_SCALE_IMAGE: the image is downscaled by powers of the scale factor
+ *   and scanned with a step of 2 pixels (1 pixel once the image is scaled by more than 2).
+ * - Used as the denominator of the false positive rates, it is an estimate of the windows actually evaluated.
+ */
+double count_windows(Size image, Size window, double scale_factor);
+
+/*
+ * Counts of the windows of a set of negative images accepted by a cascade.
+ */
+struct mining_stats
+{
+	size_t images = 0;
+	double windows = 0;
+
+	// raw windows (not grouped) accepted by the first k + 1 stages
+	vector<double> stage_windows;
+
+	// grouped detections of the full cascade, each of them a false positive
+	size_t false_positives = 0;
+
+	mining_stats(int stages = 0);
+
+	/*
+	 * Adds the counts of another set of images.
+	 */
+	void add(const mining_stats &other);
+
+	/*
+	 * Prints, for each stage, the fraction of windows accepted so far and the fraction of those accepted by
+	 * the previous stage that the stage accepts.
+	 */
+	void print(const string &name, ostream &out) const;
+};
+
+/*
+ * Scans a negative image with the truncated cascades and the full one.
+ *
+ * Parameters:
+ * - img: Negative image (BGR), it must not contain the object.
+ * - stages: Cascades truncated to 1, 2, ... stages, the last one being the full cascade.
+ * - window: Window size of the cascade.
+ * - stats: Counts updated with the image.
+ * - false_positives: Output, the detections of the full cascade.
+ *
+ * Behavior:
+ * - The image is preprocessed as in the HAAR detector (grayscale, equalized histogram).
+ */
+void scan_negative(const Mat &img, vector<CascadeClassifier> &stages, Size window, mining_stats &stats, vector<Rect> &false_positives);
+
+#endif // NEGATIVE_MINING_HPP
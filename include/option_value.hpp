@@ -0,0 +1,51 @@
+// created by Davide Baggio 2122547
+
+#ifndef OPTION_VALUE_HPP
+#define OPTION_VALUE_HPP
+
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+using namespace std;
+
+/*
+ * Parses the whole value of a numeric option, such as "512" for `--tile 512`.
+ *
+ * Behavior:
+ * - Throws `invalid_argument` if the value is not a number, has characters after it or is negative for an
+ *   unsigned type, and `out_of_range` if it does not fit in T. The option parsers report both as an invalid value.
+ */
+template <typename T>
+T parse_number(const string &text)
+{
+	size_t used = 0;
+	T value;
+	if constexpr (is_same<T, float>::value)
+		value = stof(text, &used);
+	else if constexpr (is_floating_point<T>::value)
+		value = stod(text, &used);
+	else if constexpr (is_unsigned<T>::value)
+	{
+		// stoull accepts a sign and wraps negative values around
+		if (text.find('-') != string::npos)
+			throw invalid_argument(text);
+		unsigned long long parsed = stoull(text, &used);
+		if (parsed > numeric_limits<T>::max())
+			throw out_of_range(text);
+		value = static_cast<T>(parsed);
+	}
+	else
+	{
+		long long parsed = stoll(text, &used);
+		if (parsed < numeric_limits<T>::min() || parsed > numeric_limits<T>::max())
+			throw out_of_range(text);
+		value = static_cast<T>(parsed);
+	}
+	if (used != text.size())
+		throw invalid_argument(text);
+	return value;
+}
+
+#endif // OPTION_VALUE_HPP
@@ -10,23 +10,28 @@
 #include <filesystem>
 #include <fstream>
 #include <regex>
+#include "detection_result.hpp"
+#include "category_table.hpp"
+#include "detector_base.hpp"
+#include "feature_budget.hpp"
+#include "feature_extraction.hpp"
+#include "vocabulary_tree.hpp"
+#include "view_search.hpp"
+#include "model_store.hpp"
 
 using namespace cv;
 using namespace std;
 namespace fs = filesystem;
 
-class orb_detector
+class orb_detector : public detector_base<orb_detector>
 {
 private:
 	
 	// Test image
 	Mat test;
 
-	// Different directories for the models
-	vector<string> models_path = {
-		"data/004_sugar_box/models",
-		"data/006_mustard_bottle/models",
-		"data/035_power_drill/models"};
+	// Directories of the model views of each category of the category table
+	vector<string> models_path = get_model_paths();
 	
 	// Regex pattern to match the model images
 	string pattern = R"(view.*color\.png)";
@@ -35,14 +40,40 @@ private:
 	string pattern_mask = R"(view.*mask\.png)";
 	Ptr<ORB> orb = ORB::create();
 
-	// Vector of points for each model
-	// 0: sugar, 1: mustard, 2: drill
-	vector<vector<Point>> points = vector<vector<Point>>(3);
+	// Keypoint limit ORB was created with, the budget can only lower it
+	int initial_max_features = orb->getMaxFeatures();
 
-	// Vector descriptors for each model
-	// 0: sugar, 1: mustard, 2: drill
-	vector<vector<Mat>> model_descriptors = vector<vector<Mat>>(3);
+	// Contiguous store of the model descriptors, with the view offsets
+	model_store models;
 
+	// Vector descriptors for each model, headers into the model store
+	vector<vector<Mat>> model_descriptors = vector<vector<Mat>>(models_path.size());
+
+	// Controller of the number of test keypoints described and matched in each frame
+	feature_budget budget;
+
+	// Vocabulary tree over all the model views and number of views matched per category, 0 matches every view
+	vocabulary_tree vocabulary;
+	int candidate_views = 0;
+
+	// candidate_views is the number of views matched across all categories, selected by one shared ranking
+	bool shared_views = false;
+
+	// Keypoints, descriptors, matches and display copies of the current frame, reused across frames
+	vector<KeyPoint> test_keypoints;
+	Mat test_descriptors;
+	vector<frame_tile> tiles;
+	vector<vector<int>> search_views = vector<vector<int>>(models_path.size());
+	vector<size_t> num_views = vector<size_t>(models_path.size());
+	view_search search;
+
+	// Bounded view search and coarse subsets of the model descriptors that order its views
+	bool bounded_views = false;
+	vector<vector<Mat>> model_subsets;
+
+	// Cross-check matcher, shared by the view matching tasks (matching against given descriptors is const)
+	Ptr<BFMatcher> matcher = BFMatcher::create(NORM_HAMMING, true);
+	vector<Mat> display_frames = vector<Mat>(models_path.size());
 	
 	
 	/*
@@ -53,19 +84,25 @@ private:
 	
 	/*
 	* 
-	* Helper function to get matches between an image model descriptors and image test descriptors
+	* Helper function to get matches between an image model descriptors and image test descriptors, written to `matches`
 	*/
-	vector<DMatch> get_matches(const Mat &model_descriptors, const Mat &test_descriptors);
+	void get_matches(const Mat &model_descriptors, const Mat &test_descriptors, vector<DMatch> &matches) const;
 	
 	/*
 	* 
-	* Helper function to save the points of the best matches
+	* Helper function to write the points of the best matches, with their distance, into the ORB block of the category
 	*
 	*/
-	void save_points(vector<DMatch> matches, vector<KeyPoint> test_keypoints, int category);
+	void save_points(const vector<DMatch> &matches, const vector<KeyPoint> &test_keypoints, int category, frame_result &result);
 
 public:
 
+	// Block of the frame result the detector writes to
+	static constexpr detector_id id = DETECTOR_ORB;
+
+	// The test features can be extracted only inside the regions of the frame result
+	static constexpr bool supports_regions = true;
+
 	/*
 	 * Constructor
 	 *
@@ -79,49 +116,99 @@ public:
 	orb_detector();
 	
 	
-	/*
-	 * Returns the points
-	 */ 
-	vector<vector<Point>> get_points();
-
-
-	/*
-	 * Returns the points with a percentage of the best matches
-	 */ 
-	vector<vector<Point>> get_points(float perc);
-	
 	/*
 	 * Parameters:
 	 * - img: test image
+	 * - result: frame result the points of the best matches are written to
 	 *
 	 * Behavior:
 	 * - Computes the detection between the model descriptors and the test image descriptors
-	 * - Compute the descriptors for the test image
+	 * - Compute the descriptors for the test image, only inside the regions of the result if enabled
 	 * - For each model image, get the best match, which are the most numerous matches from a single image model
 	 * - The maximum number of matches is considered the best match
 	 * - Sort matches by distance to prioritize the most reliable matches (smallest distance first)
+	 * - The best points of a category are then available as result.top(DETECTOR_ORB, category, perc)
 	 * 
 	 */ 
-	void compute_detection(Mat img);
+	void compute_detection(const Mat &img, frame_result &result);
 	
 	/*
 	 * 
+	 * Parameters:
+	 * - result: frame result previously filled by compute_detection
+	 *
 	 * Behavior:
 	 * - Displays all the points of the best matches
 	 *
 	 */
-	void display_points();
+	void display_points(const frame_result &result);
 	
 	/*
 	 * 
 	 * Parameters:
+	 * - result: frame result previously filled by compute_detection
 	 * - perc: percentage of the best matches to display
 	 *
 	 * Behavior:
 	 * - Displays the points of the best matches with a percentage of the best matches
 	 *
 	 */
-	void display_points(float perc);
+	void display_points(const frame_result &result, float perc);
+
+	/*
+	 *
+	 * Parameters:
+	 * - budget_ms: time budget of the ORB stage of a frame in milliseconds, 0 disables the budget
+	 * - max_keypoints: maximum number of test keypoints kept in a frame
+	 *
+	 * Behavior:
+	 * - Limits the test keypoints to the strongest ones that fit in the budget, the limit is also
+	 *   used as the maximum number of features of the ORB detector
+	 *
+	 */
+	void set_budget(double budget_ms, int max_keypoints);
+
+	/*
+	 *
+	 * Parameters:
+	 * - views: number of model views matched per category, 0 matches every view
+	 * - shared: select the best `views` across all categories instead of in each of them
+	 *
+	 * Behavior:
+	 * - Builds the vocabulary tree over the model descriptors the first time it is enabled
+	 * - In each frame only the views with the highest bag of words score are matched
+	 *
+	 */
+	void set_view_preselection(int views, bool shared = false);
+
+	/*
+	 *
+	 * Parameters:
+	 * - enable: search the model views with early termination
+	 *
+	 * Behavior:
+	 * - Keeps a coarse subset of the descriptors of every model view
+	 * - In each frame the views of a category are matched from the previous winner and then by the matches
+	 *   of their subset, until the best count is above what the views left can reach
+	 *
+	 */
+	void set_bounded_views(bool enable);
+
+	/*
+	 *
+	 * Parameters:
+	 * - enable: back the model store by huge pages
+	 *
+	 * Behavior:
+	 * - Repacks the model descriptors into new blocks, on huge pages if the system provides them
+	 *
+	 */
+	void set_huge_pages(bool enable);
+
+	const feature_budget &get_budget() const;
+
+	// Bounded view search, with the number of views matched per frame
+	const view_search &get_view_search() const;
 };
 
 #endif // ORB_DETECTOR_HPP
\ No newline at end of file
@@ -0,0 +1,114 @@
+// created by Davide Baggio 2122547
+
+#ifndef PIPELINE_CONFIG_HPP
+#define PIPELINE_CONFIG_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Runtime options of the detection pipeline, filled from the command line.
+ */
+struct pipeline_config
+{
+	// print the memory accounting report at exit
+	bool mem_report = false;
+	// period of the memory sampler in milliseconds, 0 disables it
+	unsigned mem_sample_ms = 0;
+	// memory in MB kept by the Mat buffer pool to recycle buffers across frames, 0 disables the pool
+	size_t mat_pool_mb = 0;
+
+	// run the detectors adaptively, skipping the expensive ones once the categories are found confidently
+	bool cascade = false;
+	// confidence every category must reach to skip the remaining detectors
+	float cascade_threshold = 0.5f;
+	// cluster size that gives full confidence on the size
+	int cascade_target_points = 20;
+
+	// expansion of the HAAR detections used as regions for ORB and SIFT, 0 extracts on the full frame
+	float roi_expand = 0.0f;
+
+	// processing resolution as a fraction of the native one, detections are mapped back to native coordinates
+	float scale = 1.0f;
+	// decode the frames in full even when the processing scale allows a reduced JPEG decode
+	bool full_decode = false;
+	// refine the final boxes with the region detectors at native resolution
+	bool refine = false;
+	// expansion of the boxes searched by the refinement
+	float refine_expand = 0.25f;
+	// scales of the latency/IoU benchmark, empty for a normal run
+	vector<float> scale_sweep;
+
+	// time budget in milliseconds of the ORB and SIFT stages of a frame, 0 keeps every keypoint
+	double feature_budget_ms = 0.0;
+	// maximum number of test keypoints ORB and SIFT keep in a frame
+	int max_keypoints = 2000;
+
+	// model views matched per category after the vocabulary tree preselection, 0 matches every view
+	int candidate_views = 0;
+	// candidate_views counts the views matched across all categories, ranked together by the vocabulary tree
+	bool shared_views = false;
+
+	// storage of the SIFT descriptors: "float", "uint8", "pca32" or "pca64"
+	string sift_descriptors = "float";
+
+	// back the model descriptor stores by huge pages
+	bool huge_pages = false;
+
+	// cascade features of each category ("haar" or "lbp"), missing entries keep the HAAR cascade
+	vector<string> cascade_types;
+	// compare the latency and IoU of the HAAR and LBP cascades of every category
+	bool cascade_benchmark = false;
+
+	// process the categories of a frame (matching, fusion, clustering) as parallel tasks
+	bool parallel_categories = true;
+	// match every model view of every category as a parallel task
+	bool parallel_views = true;
+	// match the views of a category from the most promising one and stop when the others cannot win
+	bool bounded_views = false;
+
+	// process frames larger than this many pixels per side as overlapping tiles, 0 processes whole frames
+	int tile_size = 0;
+	// pixels processed around the part of the frame each tile owns
+	int tile_halo = 128;
+
+	// format of the annotations: "jsonl" appends every frame to one file, "text" writes a file per frame
+	string annotations = "jsonl";
+
+	// print the per-frame lines of the detectors
+	bool frame_log = true;
+
+	// pack the dataset is read from, empty reads the data directory
+	string dataset_pack;
+
+	// Unix domain socket the detection daemon listens on, empty processes the test images and exits
+	string daemon_socket;
+	// frames the daemon processes at once, each with its own detectors and buffers
+	int daemon_workers = 1;
+};
+
+/*
+ * Parses the command line options into a `pipeline_config`.
+ *
+ * Parameters:
+ * - argc, argv: Arguments of `main`.
+ *
+ * Returns:
+ * - The parsed configuration, options not given keep their default value.
+ *
+ * Behavior:
+ * - Unknown options, missing values and values that are not numbers print an error and the usage, then the
+ *   program exits.
+ * - `--help` prints the usage and exits.
+ */
+pipeline_config parse_config(int argc, char **argv);
+
+/*
+ * Prints the list of supported command line options.
+ */
+void print_usage(const string &program);
+
+#endif // PIPELINE_CONFIG_HPP
@@ -10,12 +10,21 @@
 #include <filesystem>
 #include <fstream>
 #include <regex>
+#include "detection_result.hpp"
+#include "category_table.hpp"
+#include "detector_base.hpp"
+#include "feature_budget.hpp"
+#include "feature_extraction.hpp"
+#include "vocabulary_tree.hpp"
+#include "view_search.hpp"
+#include "descriptor_codec.hpp"
+#include "model_store.hpp"
 
 using namespace cv;
 using namespace std;
 using namespace filesystem;
 
-class sift_detector
+class sift_detector : public detector_base<sift_detector>
 {
 	private:
 
@@ -28,20 +37,42 @@ class sift_detector
 		// Regex pattern to match the model images
 		string pattern = R"(view.*color\.png)";
 
-		// Different directories for the models
-		vector<string> models_path = {
-			"data/004_sugar_box/models",
-			"data/006_mustard_bottle/models",
-			"data/035_power_drill/models"};
+		// Directories of the model views of each category of the category table
+		vector<string> models_path = get_model_paths();
 
 
-		// Vector of points for each model
-		// 0: sugar, 1: mustard, 2: drill
-		vector<vector<Point>> points = vector<vector<cv::Point>>(3);
+		// Contiguous store of the model descriptors, with the view offsets
+		model_store models;
 
-		// Vector descriptors for each model
-		// 0: sugar, 1: mustard, 2: drill
-		vector<vector<Mat>> model_descriptors = vector<vector<Mat>>(3);
+		// Vector descriptors for each model, headers into the model store
+		vector<vector<Mat>> model_descriptors = vector<vector<Mat>>(models_path.size());
+
+		// Controller of the number of test keypoints described and matched in each frame
+		feature_budget budget;
+
+		// Vocabulary tree over all the model views and number of views matched per category, 0 matches every view
+		vocabulary_tree vocabulary;
+		int candidate_views = 0;
+
+		// candidate_views is the number of views matched across all categories, selected by one shared ranking
+		bool shared_views = false;
+
+		// Representation of the model and test descriptors, float unless a compact mode is set
+		descriptor_codec codec;
+
+		// Equalized frame, keypoints, descriptors, matches and display copies of the current frame, reused across frames
+		Mat img_opt;
+		vector<KeyPoint> img_kpt;
+		Mat img_desc;
+		vector<frame_tile> tiles;
+		vector<vector<int>> search_views = vector<vector<int>>(models_path.size());
+		vector<size_t> num_views = vector<size_t>(models_path.size());
+		view_search search;
+
+		// Bounded view search and coarse subsets of the model descriptors that order its views
+		bool bounded_views = false;
+		vector<vector<Mat>> model_subsets;
+		vector<Mat> display_frames = vector<Mat>(models_path.size());
 		
 		/*
 		* Extracts and stores the SIFT descriptors for each object model using the provided masks.
@@ -71,62 +102,72 @@ class sift_detector
 		* Optimizes an input image by converting it to grayscale and applying histogram equalization.
 		*
 		* Parameters:
-		* - src: A reference to the input image (cv::Mat) to be optimized. It will be modified in place.
+		* - src: The input BGR image (cv::Mat) to be optimized.
+		* - dst: The grayscale equalized image, may not be `src`.
 		*
 		* Returns:
-		* - None (the function modifies the input `src` directly).
+		* - None (the processed image is written to `dst`).
 		*
 		* Behavior:
 		* - Converts the input color image from BGR to grayscale.
-		* - Applies histogram equalization to enhance the contrast of the grayscale image.
-		* - Replaces the original image with the processed (equalized) grayscale image.
+		* - Applies histogram equalization in place to enhance the contrast of the grayscale image.
+		* - `dst` keeps its buffer when it already has the size of the result, so no temporary image is allocated.
 		*
 		*/
-		void optimize_image(Mat &src);
+		void optimize_image(const Mat &src, Mat &dst);
 		
 		/*
-		* Saves the points corresponding to the matched keypoints between the test image and the model.
+		* Writes the points corresponding to the matched keypoints between the test image and the model into the frame result.
 		*
 		* Parameters:
 		* - matches: A vector of DMatch objects representing the matches between keypoints in the test image and the model.
 		* - img_kpt: A vector of KeyPoint objects representing the detected keypoints in the test image.
 		* - category: An integer representing the object category for which the keypoints are being saved.
+		* - result: The frame result the points are written to.
 		*
 		* Returns:
-		* - None (the function modifies the internal `points` map).
+		* - None (the function writes the SIFT block of `category` in `result`).
 		*
 		* Behavior:
 		* - Iterates over the matches and retrieves the corresponding keypoints' positions from the test image (`img_kpt`).
-		* - For each match, the corresponding point (from the `trainIdx` of the `DMatch`) is added to the `matches_points` vector.
-		* - The `matches_points` vector is then stored in the `points` map, using the specified `category` as the key.
-		* - This ensures that the points are categorized by the object model they belong to.
+		* - For each match, the corresponding point (from the `trainIdx` of the `DMatch`) is appended with its match distance.
+		* - The order of the matches is kept, so sorted matches give a block sorted by distance.
 		*/
-		void save_points(vector<cv::DMatch> &matches, vector<KeyPoint> &img_kpt, int category);
+		void save_points(const vector<cv::DMatch> &matches, const vector<KeyPoint> &img_kpt, int category, frame_result &result);
 		
 		/*
-		* Computes the good matches between the model descriptors and the image descriptors using the FLANN-based matcher.
+		* Computes the good matches between the model descriptors and the image descriptors using a brute force matcher.
 		*
 		* Parameters:
 		* - model_desc: A cv::Mat containing the descriptors of the object model.
 		* - img_desc: A cv::Mat containing the descriptors of the test image.
 		*
+		* - good_matches: Filled with the good matches between the model and image descriptors.
+		*
 		* Returns:
-		* - A vector of DMatch objects representing the good matches between the model and image descriptors.
+		* - None.
 		*
 		* Behavior:
-		* - The function uses the FLANN-based matcher to find the k-nearest neighbors (k=2) for each model descriptor.
+		* - The function uses an exact brute force matcher (L2) to find the k-nearest neighbors (k=2) for each model descriptor,
+		*   or the compact descriptors when they are enabled.
 		* - For each pair of matches, it applies the Lowe's ratio test to filter out bad matches:
 		*     - If the distance of the closest match (m[0]) is significantly smaller than that of the second closest match (m[1]), it is considered a good match.
-		*     - The ratio threshold is set to 1.0, meaning that the first match should be at least twice as good as the second one.
+		*     - The ratio threshold is `match_ratio` (0.999), so only the matches whose two nearest neighbours are at the same distance are dropped.
 		* - The function returns a vector of the filtered "good matches".
 		*
 		* Notes:
-		* - The FLANN-based matcher is used for fast approximate nearest neighbor search.
-		* - The distance ratio used for filtering matches is hardcoded to 0.82.
+		* - The search is exact in the serial and in the parallel tasks, so both find the same matches and winners:
+		*   the randomized trees of FLANN draw from the global rand() and would depend on the scheduling of the tasks.
 		*/
-		vector<DMatch> get_matches(const Mat &model_desc, const Mat &img_desc);
+		void get_matches(const Mat &model_desc, const Mat &img_desc, vector<DMatch> &good_matches) const;
 
 	public:
+
+		// Block of the frame result the detector writes to
+		static constexpr detector_id id = DETECTOR_SIFT;
+
+		// The test features can be extracted only inside the regions of the frame result
+		static constexpr bool supports_regions = true;
 		
 		/*
 		* Constructor for the sift_detector class.
@@ -149,42 +190,12 @@ class sift_detector
 		*/
 		sift_detector();
 
-		/*
-		* Returns the points associated with each object category based on the detected matches.
-		*
-		* Parameters:
-		* - None
-		*
-		* Returns:
-		* - A vector of vectors of `cv::Point` objects, where each inner vector contains points corresponding to a particular object category.
-		*
-		* Behavior:
-		* - This function simply returns the `points` member variable, which stores the matched points for each object category in the form of a vector of vectors.
-		* - The `points` vector was populated during the object detection process, where each category corresponds to the points found in the test image that match a model.
-		*/
-		vector<vector<Point>> get_points();
-
-		/*
-		* Returns a subset of the points associated with each object category, based on a specified percentage.
-		*
-		* Parameters:
-		* - perc: A floating-point value between 0 and 1 representing the percentage of points to be returned for each category.
-		* 
-		* Returns:
-		* - A vector of vectors of `cv::Point` objects, where each inner vector contains a subset of points corresponding to a particular object category.
-		* 
-		* Behavior:
-		* - For each category, the function selects the top `perc` percentage of points (based on the order they were added) and stores them in a new vector.
-		* - The selected points are then returned as a vector of vectors, where each inner vector corresponds to a category and contains the filtered points.
-		* - The function ensures that only the specified percentage of points are included in the result for each category.
-		*/
-		vector<vector<Point>> get_points(float perc);
-
 		/*
 		* Computes the object detection for a given test image using the SIFT algorithm.
 		*
 		* Parameters:
 		* - img: A cv::Mat containing the test image on which object detection is to be performed.
+		* - result: The frame result the points of the winning matches are written to.
 		*
 		* Returns:
 		* - None
@@ -192,23 +203,26 @@ class sift_detector
 		* Behavior:
 		* - The function starts by cloning the input test image and applies optimization (grayscale conversion and histogram equalization) using the `optimize_image()` method.
 		* - The function then uses the SIFT algorithm to detect keypoints in the optimized test image and computes the corresponding descriptors.
+		* - If regions are enabled, keypoints are detected only inside the regions of `result` and mapped back to image coordinates.
 		* - If no descriptors are found for the test image, an error message is printed, and the function terminates early.
 		* - The function iterates through each model's descriptors (stored in `model_descriptors`), comparing them to the test image descriptors using the `get_matches()` function.
 		* - For each model, the function determines the number of matches and selects the model with the highest number of matches to the test image.
 		* - If no matches are found for a model or if the matches are below a minimum threshold, an error message is printed, and the function continues with the next model.
 		* - The selected "winning" matches (those with the highest number of matches) are stored in `winning_matches`.
+		* - The winning matches are sorted by distance and written to the SIFT block of the category, so
+		*   `result.top(DETECTOR_SIFT, category, perc)` returns the best `perc` fraction without copying.
 		*
 		* Notes:
 		* - The `get_matches()` function is used to find matches between the model and test image descriptors, and it applies Lowe's ratio test to filter the matches.
 		* - This function is used to determine which object model best matches the test image based on the number of matching keypoints.
 		*/
-		void compute_detection(Mat img_test);
+		void compute_detection(const Mat &img, frame_result &result);
 
 		/*
 		* Displays all the points associated with each object category by calling the display_points function with a percentage of 100%.
 		*
 		* Parameters:
-		* - None
+		* - result: The frame result previously filled by `compute_detection`.
 		* 
 		* Returns:
 		* - None
@@ -217,13 +231,14 @@ class sift_detector
 		* - This function is a wrapper that calls the `display_points` method with a default parameter value of `1.0`, which indicates that all the points for each category should be displayed.
 		* - It simplifies the function call for cases where the user wants to display all the points without specifying a percentage.
 		*/
-		void display_points();
+		void display_points(const frame_result &result);
 
 		/*
-		* Displays the points corresponding to each object category (sugar box, mustard bottle, and power drill) on the test image.
+		* Displays the points corresponding to each object category on the test image.
 		* The points are displayed with a green circle, and the percentage of points to be displayed is controlled by the parameter `perc`.
 		*
 		* Parameters:
+		* - result: The frame result previously filled by `compute_detection`.
 		* - perc: A float value between 0.0 and 1.0, representing the percentage of points to display for each category.
 		*         (1.0 means all points, while lower values display only a subset of points).
 		* 
@@ -231,13 +246,86 @@ class sift_detector
 		* - None
 		* 
 		* Behavior:
-		* - A clone of the test image (`img_test`) is created for each category (sugar box, mustard bottle, and power drill).
+		* - A clone of the test image (`img_test`) is created for each category.
 		* - For each object category, a subset of points is selected based on the `perc` parameter, and circles are drawn around these points on the cloned image.
 		* - If no points are found for a category, an error message is printed, and that category is skipped.
 		* - The processed images are displayed in separate windows for each object category, with the points highlighted.
 		* - The function waits for a key press before closing the display windows.
 		*/
-		void display_points(float perc);
+		void display_points(const frame_result &result, float perc);
+
+		/*
+		* Sets the feature budget of the detector.
+		*
+		* Parameters:
+		* - budget_ms: Time budget of the SIFT stage of a frame in milliseconds, 0 disables the budget.
+		* - max_keypoints: Maximum number of test keypoints kept in a frame.
+		*
+		* Behavior:
+		* - The test keypoints are reduced to the strongest ones that fit in the budget before their
+		*   descriptors are computed, so the discarded keypoints are neither described nor matched.
+		*/
+		void set_budget(double budget_ms, int max_keypoints);
+
+		/*
+		* Enables the preselection of the model views with the vocabulary tree.
+		*
+		* Parameters:
+		* - views: Number of model views matched per category, 0 matches every view.
+		* - shared: Select the best `views` across all categories instead of in each of them.
+		*
+		* Behavior:
+		* - The vocabulary tree is built over the model descriptors the first time the preselection is enabled.
+		* - In each frame the views are scored by their bag of words and only the best `views` of each
+		*   category, or of all of them when shared, go through the matching.
+		*/
+		void set_view_preselection(int views, bool shared = false);
+
+		/*
+		* Enables the bounded search of the model views.
+		*
+		* Parameters:
+		* - enable: Stop matching the views of a category once the views left cannot win.
+		*
+		* Behavior:
+		* - A coarse subset of the descriptors of every model view is kept, rebuilt if the descriptors become compact.
+		* - In each frame the previous winner is matched first, then the views with the most subset matches, until
+		*   the best count is above what the views left can reach (a view gives at most one match per descriptor).
+		*/
+		void set_bounded_views(bool enable);
+
+		/*
+		* Stores the model descriptors in a compact form and matches them in that form.
+		*
+		* Parameters:
+		* - mode: DESCRIPTOR_UINT8 (4x less memory) or DESCRIPTOR_PCA (128 / dims less memory).
+		* - dims: Number of principal components of DESCRIPTOR_PCA.
+		*
+		* Behavior:
+		* - The recall of the compact matches with respect to the float ones is measured on pairs of model views
+		*   and printed with the memory of the model descriptors before and after the encoding.
+		* - The model descriptors are replaced by their compact form, the test descriptors of each frame are encoded
+		*   before matching and matched by brute force directly in that form instead of as floats.
+		* - It can be applied only once.
+		*/
+		void set_descriptor_mode(descriptor_mode mode, int dims);
+
+		/*
+		* Backs the model store by huge pages.
+		*
+		* Parameters:
+		* - enable: True to allocate the store on huge pages.
+		*
+		* Behavior:
+		* - The model descriptors are repacked into new blocks, on huge pages if the system provides them,
+		*   otherwise on regular 64-byte aligned memory.
+		*/
+		void set_huge_pages(bool enable);
+
+		const feature_budget &get_budget() const;
+
+		// Bounded view search, with the number of views matched per frame
+		const view_search &get_view_search() const;
 };
 
 #endif // SIFT_DETECTOR_HPP
\ No newline at end of file
@@ -0,0 +1,239 @@
+// created by Davide Baggio 2122547
+
+#ifndef VIEW_SEARCH_HPP
+#define VIEW_SEARCH_HPP
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "category_tasks.hpp"
+
+using namespace std;
+using namespace cv;
+
+/*
+ * Search of the model view that best matches a frame, for every category.
+ *
+ * The views of all categories are matched as independent tasks, each writing the matches of its view to its
+ * own buffer, then every category keeps the view with the most matches. Ties go to the view that comes first
+ * in the search order, the same view a serial loop with a strict comparison keeps, so the winner does not
+ * depend on the number of threads or on the order the tasks run in.
+ *
+ * The bounded search matches the views of a category one at a time, in the order of a cheap prior: the view
+ * that won the previous frame first, then the others by the matches of a coarse subset of their descriptors.
+ * It stops as soon as the best count exceeds the limit of every view left, so the views that cannot win are
+ * never matched in full.
+ */
+
+// one model descriptor out of this many is kept in the coarse subset a view is scored on
+const static int coarse_subset_stride = 8;
+
+// a view is expected to reach at most this multiple of its coarse estimate, plus one subset stride
+const static float view_bound_margin = 1.25f;
+
+class view_search
+{
+private:
+	// matches of each view of a category, by position in the search order, reused across frames
+	vector<vector<vector<DMatch>>> view_matches;
+
+	// winning position of each category, -1 if no view has matches
+	vector<int> winners;
+
+	// (category, position) of every view matched in the frame
+	vector<pair<int, int>> jobs;
+
+	// coarse estimate and provable upper bound of the matches of each view of the bounded search, by position
+	vector<vector<size_t>> estimates;
+	vector<vector<size_t>> bounds;
+
+	// evaluation order of each category and, for each step of the order, the highest limit of the views left
+	vector<vector<int>> orders;
+	vector<vector<size_t>> remaining_limits;
+
+	// view identifiers that won the previous bounded search, -1 if none
+	vector<int> previous_views;
+
+	// views matched in full by each category in the frame
+	vector<size_t> evaluated;
+
+	// bounded searches, views matched in full and views available over the run
+	size_t searches = 0;
+	size_t views_evaluated = 0;
+	size_t views_available = 0;
+
+	/*
+	 * Fills the evaluation order and the remaining limits of a category from the estimates and the bounds.
+	 */
+	void order_views(int category, const vector<int> &views);
+
+public:
+	/*
+	 * Parameters:
+	 * - num_categories: Number of categories searched, the buffers are resized to the views of each search.
+	 */
+	view_search(int num_categories = 0);
+
+	/*
+	 * Matches the views of every category and selects the winners.
+	 *
+	 * Parameters:
+	 * - num_views: Number of views to match for each category.
+	 * - parallel_views: Match all the views of all the categories as parallel tasks.
+	 * - parallel_categories: If the views are not parallel, still match the categories in parallel.
+	 * - match: Callable `(int category, int position, vector<DMatch> &matches)` that matches a view of a
+	 *   category, identified by its position in the search order; it must only read shared data.
+	 */
+	template <typename view_matcher>
+	void run(const vector<size_t> &num_views, bool parallel_views, bool parallel_categories, const view_matcher &match)
+	{
+		int num_categories = static_cast<int>(num_views.size());
+		view_matches.resize(num_categories);
+		winners.assign(num_categories, -1);
+
+		jobs.clear();
+		for (int i = 0; i < num_categories; i++)
+		{
+			view_matches[i].resize(num_views[i]);
+			for (size_t c = 0; c < num_views[i]; c++)
+				jobs.emplace_back(i, static_cast<int>(c));
+		}
+
+		if (parallel_views)
+		{
+			auto match_job = [&](int k)
+			{
+				int i = jobs[k].first;
+				int c = jobs[k].second;
+				match(i, c, view_matches[i][c]);
+			};
+			run_tasks(static_cast<int>(jobs.size()), true, match_job);
+		}
+		else
+		{
+			auto match_category = [&](int i)
+			{
+				for (size_t c = 0; c < num_views[i]; c++)
+					match(i, static_cast<int>(c), view_matches[i][c]);
+			};
+			run_category_tasks(num_categories, parallel_categories, match_category);
+		}
+
+		for (int i = 0; i < num_categories; i++)
+			winners[i] = select_winner(view_matches[i], num_views[i]);
+	}
+
+	/*
+	 * Matches the views of every category in the order of a prior and stops when no view left can win.
+	 *
+	 * Parameters:
+	 * - views: Identifiers of the views to match for each category, in the search order, the identifiers let
+	 *   the view that won the previous frame be found again when the candidate views change.
+	 * - parallel_views: Score all the views of all the categories as parallel tasks.
+	 * - parallel_categories: Search the categories in parallel, the views of a category are always matched in
+	 *   sequence since each one decides whether the next is needed.
+	 * - match: Callable `(int category, int position, vector<DMatch> &matches)` as in `run`.
+	 * - score: Callable `(int category, int position, size_t &estimate, size_t &bound)` that estimates the
+	 *   matches of a view cheaply and gives a count its full matching cannot exceed.
+	 *
+	 * Behavior:
+	 * - A view is skipped when the best count is above its limit, the lower of its bound and of the margin
+	 *   over its estimate: the bound stop is exact, the estimate stop is statistical.
+	 * - The winner is the view with the most matches among the ones matched, the lowest position on ties.
+	 */
+	template <typename view_matcher, typename view_scorer>
+	void run_bounded(const vector<vector<int>> &views, bool parallel_views, bool parallel_categories, const view_matcher &match,
+					 const view_scorer &score)
+	{
+		int num_categories = static_cast<int>(views.size());
+		view_matches.resize(num_categories);
+		winners.assign(num_categories, -1);
+		estimates.resize(num_categories);
+		bounds.resize(num_categories);
+		orders.resize(num_categories);
+		remaining_limits.resize(num_categories);
+		previous_views.resize(num_categories, -1);
+		evaluated.assign(num_categories, 0);
+
+		jobs.clear();
+		for (int i = 0; i < num_categories; i++)
+		{
+			view_matches[i].resize(views[i].size());
+			estimates[i].assign(views[i].size(), 0);
+			bounds[i].assign(views[i].size(), 0);
+			for (size_t c = 0; c < views[i].size(); c++)
+				jobs.emplace_back(i, static_cast<int>(c));
+		}
+
+		auto score_job = [&](int k)
+		{
+			int i = jobs[k].first;
+			int c = jobs[k].second;
+			score(i, c, estimates[i][c], bounds[i][c]);
+		};
+		run_tasks(static_cast<int>(jobs.size()), parallel_views, score_job);
+
+		auto search_category = [&](int i)
+		{
+			order_views(i, views[i]);
+			const vector<int> &order = orders[i];
+
+			size_t best = 0;
+			size_t k = 0;
+			for (; k < order.size() && best <= remaining_limits[i][k]; k++)
+			{
+				vector<DMatch> &matches = view_matches[i][order[k]];
+				match(i, order[k], matches);
+				best = max(best, matches.size());
+			}
+			evaluated[i] = k;
+
+			// the views left keep no matches from previous frames
+			for (; k < order.size(); k++)
+				view_matches[i][order[k]].clear();
+		};
+		run_category_tasks(num_categories, parallel_categories, search_category);
+
+		searches++;
+		for (int i = 0; i < num_categories; i++)
+		{
+			winners[i] = select_winner(view_matches[i], views[i].size());
+			previous_views[i] = winners[i] >= 0 ? views[i][winners[i]] : -1;
+			views_evaluated += evaluated[i];
+			views_available += views[i].size();
+		}
+	}
+
+	/*
+	 * Returns the coarse subset of the descriptors of a view, one row out of `coarse_subset_stride`.
+	 */
+	static Mat coarse_subset(const Mat &descriptors);
+
+	/*
+	 * Prints the average number of views matched in full per frame by the bounded search.
+	 */
+	void print_stats(const string &name, ostream &out) const;
+
+	/*
+	 * Returns the position of the view with the most matches among the first `count`, the lowest position on
+	 * ties, -1 if none has matches.
+	 */
+	static int select_winner(const vector<vector<DMatch>> &matches, size_t count);
+
+	/*
+	 * Returns the winning position of a category in the last search, -1 if no view has matches.
+	 */
+	int get_winner(int category) const;
+
+	/*
+	 * Returns the matches of the winning view of a category in the last search.
+	 *
+	 * Behavior:
+	 * - The buffer is owned by the search and reused in the next frame, it may be sorted in place.
+	 */
+	vector<DMatch> &get_winning_matches(int category);
+};
+
+#endif // VIEW_SEARCH_HPP
@@ -0,0 +1,153 @@
+// created by Davide Baggio 2122547
+
+#ifndef VOCABULARY_TREE_HPP
+#define VOCABULARY_TREE_HPP
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+/*
+ * Bag of visual words vocabulary tree with an inverted file over the model views of every category.
+ *
+ * The descriptors of all views are clustered by hierarchical k-means, each leaf of the tree is a visual word.
+ * A view is described by the tf-idf weights of its words, normalized to unit L1 norm, and the inverted file
+ * lists for each word the views containing it.
+ *
+ * A frame is scored against the views by quantizing its descriptors (branching * depth distances each) and
+ * walking only the inverted lists of its words, so the cost grows with the number of words shared with the
+ * views rather than with the number of views.
+ *
+ * Binary descriptors (ORB) are unpacked into one float per bit, so the squared L2 distance used by k-means is
+ * their Hamming distance. Other descriptors (SIFT, also in compact form) are converted to floats.
+ */
+class vocabulary_tree
+{
+private:
+	// node of the tree, `children` is the index of the first of its `branching` children, -1 for leaves
+	struct node
+	{
+		Mat centers;
+		int children = -1;
+		int word = -1;
+	};
+
+	// entry of the inverted file: a view and the weight of the word in it
+	struct posting
+	{
+		int view;
+		float weight;
+	};
+
+	int branching;
+	int depth;
+
+	// descriptors are bit strings
+	bool binary = false;
+
+	vector<node> nodes;
+	int num_words = 0;
+
+	// inverse document frequency of each word
+	vector<float> idf;
+
+	// views containing each word
+	vector<vector<posting>> inverted;
+
+	// category and index in its category of each view
+	vector<int> view_category;
+	vector<int> view_index;
+	int num_categories = 0;
+
+	/*
+	 * Splits the rows of `data` among the children of `node_id` and recurses until `level` reaches the depth.
+	 */
+	void build_node(int node_id, const Mat &data, int level);
+
+	/*
+	 * Returns the word of a single descriptor row, descending the tree to a leaf.
+	 */
+	int quantize(const float *descriptor, int length) const;
+
+	/*
+	 * Returns the tf-idf weights of the words of `descriptors`, normalized to unit L1 norm, sorted by word.
+	 */
+	vector<pair<int, float>> bag_of_words(const Mat &descriptors) const;
+
+	/*
+	 * Scores every view against the bag of words of `descriptors`, walking the inverted lists of its words.
+	 */
+	void score_views(const Mat &descriptors, vector<float> &scores) const;
+
+	/*
+	 * Converts descriptors to the float rows the tree works on, unpacking the bits of binary descriptors.
+	 */
+	Mat to_float(const Mat &descriptors) const;
+
+public:
+	/*
+	 * Parameters:
+	 * - branching: Number of children of each node.
+	 * - depth: Number of levels of the tree, the vocabulary has up to branching^depth words.
+	 */
+	vocabulary_tree(int branching = 8, int depth = 4);
+
+	/*
+	 * Builds the tree and the inverted file.
+	 *
+	 * Parameters:
+	 * - model_descriptors: Descriptors of each view of each category, as stored by the detectors.
+	 * - binary: True for bit string descriptors compared by Hamming distance (ORB).
+	 *
+	 * Behavior:
+	 * - The clustering is seeded, so the same models always give the same vocabulary.
+	 * - Views without descriptors are kept in the index but never selected.
+	 */
+	void build(const vector<vector<Mat>> &model_descriptors, bool binary);
+
+	/*
+	 * Returns true if the tree has not been built.
+	 */
+	bool empty() const;
+
+	/*
+	 * Selects the views that best match a frame.
+	 *
+	 * Parameters:
+	 * - descriptors: Descriptors of the frame.
+	 * - k: Number of views selected for each category.
+	 * - views: Output, indices of the selected views of each category, best first.
+	 *
+	 * Behavior:
+	 * - Views are scored by the intersection of their bag of words with the one of the frame
+	 *   (equivalent to the L1 distance of the normalized vectors).
+	 * - Categories with fewer than `k` views return all of them, views sharing no word with the frame
+	 *   are ranked last by index.
+	 */
+	void select_views(const Mat &descriptors, int k, vector<vector<int>> &views) const;
+
+	/*
+	 * Selects the views that best match a frame among the views of all categories.
+	 *
+	 * Parameters:
+	 * - descriptors: Descriptors of the frame.
+	 * - k: Number of views selected in total.
+	 * - views: Output, indices of the selected views of each category, best first.
+	 *
+	 * Behavior:
+	 * - The views are ranked once over the shared inverted file, so the number of views matched per frame
+	 *   does not grow with the number of categories.
+	 * - Categories with no view among the best `k` get an empty list, views sharing no word with the frame
+	 *   are never selected.
+	 */
+	void select_shared(const Mat &descriptors, int k, vector<vector<int>> &views) const;
+
+	/*
+	 * Returns the number of visual words of the vocabulary.
+	 */
+	int get_num_words() const;
+};
+
+#endif // VOCABULARY_TREE_HPP
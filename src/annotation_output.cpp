@@ -0,0 +1,157 @@
+// created by Davide Baggio 2122547
+
+#include "annotation_output.hpp"
+
+/*
+ * Appends a string to a JSON line, escaping quotes and backslashes.
+ */
+static void append_json_string(string &out, const string &value)
+{
+	out += '"';
+	for (char c : value)
+	{
+		if (c == '"' || c == '\\')
+			out += '\\';
+		out += c;
+	}
+	out += '"';
+}
+
+/*
+ * Reads the JSON string starting at the quote at `pos`, leaving `pos` after the closing quote.
+ */
+static bool parse_json_string(const string &line, size_t &pos, string &value)
+{
+	if (pos >= line.size() || line[pos] != '"')
+		return false;
+	value.clear();
+	for (pos++; pos < line.size(); pos++)
+	{
+		if (line[pos] == '\\' && pos + 1 < line.size())
+			value += line[++pos];
+		else if (line[pos] == '"')
+		{
+			pos++;
+			return true;
+		}
+		else
+			value += line[pos];
+	}
+	return false;
+}
+
+/*
+ * Reads the integer value of a key, searching from `pos` and leaving `pos` after the number.
+ */
+static bool parse_json_int(const string &line, const string &key, size_t &pos, int &value)
+{
+	pos = line.find("\"" + key + "\":", pos);
+	if (pos == string::npos)
+		return false;
+	pos += key.size() + 3;
+	char *end;
+	value = static_cast<int>(strtol(line.c_str() + pos, &end, 10));
+	pos = end - line.c_str();
+	return true;
+}
+
+void format_annotation_line(const string &frame, const vector<string> &names, const vector<Rect> &boxes, string &line)
+{
+	line.clear();
+	line += "{\"frame\":";
+	append_json_string(line, frame);
+	line += ",\"boxes\":[";
+	for (size_t c = 0; c < names.size() && c < boxes.size(); c++)
+	{
+		const Rect &box = boxes[c];
+		line += c > 0 ? ",{\"class\":" : "{\"class\":";
+		append_json_string(line, names[c]);
+		line += ",\"x1\":" + to_string(box.x) + ",\"y1\":" + to_string(box.y) + ",\"x2\":" + to_string(box.x + box.width) +
+				",\"y2\":" + to_string(box.y + box.height) + "}";
+	}
+	line += "]}\n";
+}
+
+bool parse_annotation_format(const string &name, annotation_format &format)
+{
+	if (name == "text")
+		format = ANNOTATIONS_TEXT;
+	else if (name == "jsonl")
+		format = ANNOTATIONS_JSONL;
+	else
+		return false;
+	return true;
+}
+
+annotation_writer::annotation_writer(annotation_format format, const string &output_dir) : format(format), output_dir(output_dir)
+{
+}
+
+bool annotation_writer::open()
+{
+	if (format != ANNOTATIONS_JSONL)
+		return true;
+	jsonl.open(output_dir + annotations_file, ios::trunc);
+	return jsonl.is_open();
+}
+
+bool annotation_writer::write(const string &frame, const vector<string> &names, const vector<Rect> &boxes)
+{
+	if (format == ANNOTATIONS_TEXT)
+	{
+		ofstream file(output_dir + frame + "-box.txt");
+		if (!file.is_open())
+			return false;
+		for (size_t c = 0; c < names.size() && c < boxes.size(); c++)
+		{
+			const Rect &box = boxes[c];
+			file << names[c] << " " << box.x << " " << box.y << " " << box.x + box.width << " " << box.y + box.height;
+			if (c + 1 < names.size())
+				file << endl;
+		}
+		return true;
+	}
+
+	format_annotation_line(frame, names, boxes, line);
+
+	// no flush per frame, the stream buffer batches the lines
+	jsonl.write(line.data(), line.size());
+	return static_cast<bool>(jsonl);
+}
+
+void annotation_writer::close()
+{
+	if (jsonl.is_open())
+		jsonl.close();
+}
+
+bool read_annotations(const string &path, map<string, map<string, Rect>> &frames)
+{
+	ifstream file(path);
+	if (!file.is_open())
+		return false;
+
+	string line, frame, name;
+	while (getline(file, line))
+	{
+		size_t pos = line.find("\"frame\":");
+		if (pos == string::npos)
+			continue;
+		pos += 8;
+		if (!parse_json_string(line, pos, frame))
+			continue;
+
+		map<string, Rect> &boxes = frames[frame];
+		boxes.clear();
+		while ((pos = line.find("\"class\":", pos)) != string::npos)
+		{
+			pos += 8;
+			int x1, y1, x2, y2;
+			if (!parse_json_string(line, pos, name) || !parse_json_int(line, "x1", pos, x1) || !parse_json_int(line, "y1", pos, y1) ||
+				!parse_json_int(line, "x2", pos, x2) || !parse_json_int(line, "y2", pos, y2))
+				break;
+			boxes[name] = Rect(x1, y1, x2 - x1, y2 - y1);
+		}
+	}
+	return true;
+}
@@ -0,0 +1,157 @@
+// created by Davide Baggio 2122547
+
+#include "category_table.hpp"
+#include "dataset_pack.hpp"
+#include "detection.hpp"
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <sstream>
+
+/*
+ * Returns the color check of a color name, null if the name is unknown.
+ */
+static bool (*parse_color(const string &name))(Vec3b)
+{
+	if (name == "yellow")
+		return is_yellow;
+	if (name == "dark")
+		return is_dark;
+	if (name == "white")
+		return is_white;
+	if (name == "red")
+		return is_red;
+	if (name == "blue")
+		return is_blue;
+	return nullptr;
+}
+
+/*
+ * Returns the drawing color of a category: blue, green and red for the first three, then hues spread by the
+ * golden ratio so that neighbouring categories stay distinguishable.
+ */
+static Scalar make_display_color(int index)
+{
+	const Scalar first[] = {Scalar(255, 0, 0), Scalar(0, 255, 0), Scalar(0, 0, 255)};
+	if (index < 3)
+		return first[index];
+
+	double hue = fmod(index * 0.618033988749895, 1.0) * 6.0;
+	double x = 1.0 - fabs(fmod(hue, 2.0) - 1.0);
+	double r = 0, g = 0, b = 0;
+	switch (static_cast<int>(hue))
+	{
+	case 0: r = 1, g = x; break;
+	case 1: r = x, g = 1; break;
+	case 2: g = 1, b = x; break;
+	case 3: g = x, b = 1; break;
+	case 4: r = x, b = 1; break;
+	default: r = 1, b = x; break;
+	}
+	return Scalar(255 * b, 255 * g, 255 * r);
+}
+
+bool category_info::accept_color(Vec3b pixel) const
+{
+	if (colors.empty())
+		return true;
+	for (bool (*is_color)(Vec3b) : colors)
+	{
+		if (is_color(pixel))
+			return true;
+	}
+	return false;
+}
+
+vector<category_info> discover_categories(const string &data_dir)
+{
+	vector<category_info> categories;
+	string root = data_dir.back() == '/' ? data_dir.substr(0, data_dir.size() - 1) : data_dir;
+
+	for (const string &dir : list_dataset_dirs(root))
+	{
+		vector<string> subdirs = list_dataset_dirs(dir);
+		if (find(subdirs.begin(), subdirs.end(), dir + "/models") == subdirs.end())
+			continue;
+
+		category_info category;
+		category.name = dir.substr(dir.find_last_of('/') + 1);
+		category.folder = category.name + "/";
+		category.display_color = make_display_color(static_cast<int>(categories.size()));
+
+		string text;
+		if (read_dataset_text(dir + "/" + colors_file, text))
+		{
+			stringstream names(text);
+			string name;
+			while (names >> name)
+			{
+				bool (*is_color)(Vec3b) = parse_color(name);
+				if (is_color)
+					category.colors.push_back(is_color);
+				else
+					cerr << "[ERROR]: unknown color " << name << " in " << dir << "/" << colors_file << endl;
+			}
+		}
+		categories.push_back(category);
+	}
+	return categories;
+}
+
+// categories of the dataset, set once a discovery finds at least one and never changed after
+static vector<category_info> categories;
+static atomic<bool> categories_found{false};
+static mutex discovery_lock;
+
+const vector<category_info> &get_categories()
+{
+	if (categories_found.load(memory_order_acquire))
+		return categories;
+
+	// an empty table is not kept, the data may become available later
+	lock_guard<mutex> guard(discovery_lock);
+	if (!categories_found.load(memory_order_relaxed))
+	{
+		categories = discover_categories(base);
+		categories_found.store(!categories.empty(), memory_order_release);
+	}
+	return categories;
+}
+
+bool categories_discovered()
+{
+	return categories_found.load(memory_order_acquire);
+}
+
+int get_num_categories()
+{
+	return static_cast<int>(get_categories().size());
+}
+
+vector<string> get_category_names()
+{
+	vector<string> names;
+	for (const category_info &category : get_categories())
+		names.push_back(category.name);
+	return names;
+}
+
+vector<string> get_model_paths()
+{
+	vector<string> paths;
+	for (const category_info &category : get_categories())
+		paths.push_back(base + category.folder + "models");
+	return paths;
+}
+
+vector<String> get_test_images()
+{
+	vector<String> filenames;
+	for (const category_info &category : get_categories())
+	{
+		vector<String> category_filenames;
+		glob_dataset(base + category.folder + img_path, category_filenames);
+		filenames.insert(filenames.end(), category_filenames.begin(), category_filenames.end());
+	}
+	return filenames;
+}
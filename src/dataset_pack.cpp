@@ -0,0 +1,449 @@
+// created by Davide Baggio 2122547
+
+#include "dataset_pack.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = filesystem;
+
+// identification of the file format
+const static char pack_magic[8] = {'I', 'M', 'G', 'P', 'A', 'C', 'K', '1'};
+const static uint32_t pack_version = 1;
+
+// alignment of the header and of the content of every entry
+const static size_t pack_alignment = 64;
+
+// root of the dataset the names of the pack are relative to
+const static string dataset_root = "data/";
+
+struct pack_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t count;
+	uint64_t index_offset;
+	uint64_t index_size;
+	uchar reserved[32];
+};
+
+/*
+ * Returns the name of a dataset path inside the pack, relative to the dataset root.
+ */
+static string pack_name(const string &path)
+{
+	string name = path;
+	while (name.compare(0, 2, "./") == 0)
+		name = name.substr(2);
+	if (name.compare(0, dataset_root.size(), dataset_root) == 0)
+		name = name.substr(dataset_root.size());
+	// the root itself, as named without its trailing slash
+	else if (name + "/" == dataset_root)
+		name.clear();
+	return name;
+}
+
+/*
+ * Writes zeros up to the next multiple of the pack alignment.
+ */
+static void pad(ofstream &out)
+{
+	static const char zeros[pack_alignment] = {0};
+	size_t position = static_cast<size_t>(out.tellp());
+	size_t padding = (pack_alignment - position % pack_alignment) % pack_alignment;
+	out.write(zeros, padding);
+}
+
+template <typename T>
+static void write_value(string &buffer, const T &value)
+{
+	buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+static T read_value(const uchar *&data)
+{
+	T value;
+	memcpy(&value, data, sizeof(T));
+	data += sizeof(T);
+	return value;
+}
+
+dataset_pack::~dataset_pack()
+{
+	close();
+}
+
+void dataset_pack::close()
+{
+	if (mapping != nullptr)
+		munmap(mapping, mapping_size);
+	mapping = nullptr;
+	mapping_size = 0;
+	entries.clear();
+}
+
+bool dataset_pack::write(const string &data_dir, const string &pack_path, bool raw_images)
+{
+	vector<fs::path> files;
+	for (const auto &file : fs::recursive_directory_iterator(data_dir))
+	{
+		if (file.is_regular_file())
+			files.push_back(file.path());
+	}
+	sort(files.begin(), files.end());
+
+	ofstream out(pack_path, ios::binary);
+	if (!out.is_open())
+	{
+		cerr << "[ERROR]: could not write the pack " << pack_path << endl;
+		return false;
+	}
+
+	pack_header header = {};
+	memcpy(header.magic, pack_magic, sizeof(pack_magic));
+	header.version = pack_version;
+	out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+	string index;
+	for (const fs::path &file : files)
+	{
+		string name = fs::relative(file, data_dir).generic_string();
+		string extension = file.extension().string();
+		entry e;
+
+		pad(out);
+		e.offset = static_cast<uint64_t>(out.tellp());
+
+		if (raw_images && (extension == ".jpg" || extension == ".png"))
+		{
+			Mat img = imread(file.string(), IMREAD_UNCHANGED);
+			if (img.empty())
+			{
+				cerr << "[ERROR]: could not decode " << file.string() << endl;
+				return false;
+			}
+			if (!img.isContinuous())
+				img = img.clone();
+			e.kind = 1;
+			e.rows = img.rows;
+			e.cols = img.cols;
+			e.type = img.type();
+			e.size = img.total() * img.elemSize();
+			out.write(reinterpret_cast<const char *>(img.data), e.size);
+		}
+		else
+		{
+			ifstream in(file, ios::binary);
+			stringstream content;
+			content << in.rdbuf();
+			string bytes = content.str();
+			if (!in)
+			{
+				cerr << "[ERROR]: could not read " << file.string() << endl;
+				return false;
+			}
+			e.size = bytes.size();
+			out.write(bytes.data(), bytes.size());
+		}
+
+		write_value(index, e.offset);
+		write_value(index, e.size);
+		write_value(index, e.kind);
+		write_value(index, e.rows);
+		write_value(index, e.cols);
+		write_value(index, e.type);
+		write_value(index, static_cast<uint32_t>(name.size()));
+		index.append(name);
+		header.count++;
+	}
+
+	pad(out);
+	header.index_offset = static_cast<uint64_t>(out.tellp());
+	header.index_size = index.size();
+	out.write(index.data(), index.size());
+
+	out.seekp(0);
+	out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	out.close();
+	if (!out)
+	{
+		cerr << "[ERROR]: could not write the pack " << pack_path << endl;
+		return false;
+	}
+	return true;
+}
+
+bool dataset_pack::open(const string &pack_path)
+{
+	close();
+
+	int fd = ::open(pack_path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(pack_header))
+	{
+		::close(fd);
+		return false;
+	}
+
+	// private writable mapping: pages written by the caller are copied, the file is never modified
+	void *data = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED)
+		return false;
+	mapping = static_cast<uchar *>(data);
+	mapping_size = info.st_size;
+
+	pack_header header;
+	memcpy(&header, mapping, sizeof(header));
+	if (memcmp(header.magic, pack_magic, sizeof(pack_magic)) != 0 || header.version != pack_version ||
+		header.index_offset + header.index_size > mapping_size)
+	{
+		close();
+		return false;
+	}
+
+	const uchar *index = mapping + header.index_offset;
+	const uchar *index_end = index + header.index_size;
+	for (uint32_t i = 0; i < header.count; i++)
+	{
+		if (index + 36 > index_end)
+		{
+			close();
+			return false;
+		}
+		entry e;
+		e.offset = read_value<uint64_t>(index);
+		e.size = read_value<uint64_t>(index);
+		e.kind = read_value<uint32_t>(index);
+		e.rows = read_value<int32_t>(index);
+		e.cols = read_value<int32_t>(index);
+		e.type = read_value<int32_t>(index);
+		uint32_t name_size = read_value<uint32_t>(index);
+		// the pixels of a raw image are wrapped without a copy, they must fill the entry exactly
+		bool valid_pixels = e.kind == 0 || (e.rows > 0 && e.cols > 0 && e.type >= 0 &&
+											static_cast<uint64_t>(e.rows) * e.cols * CV_ELEM_SIZE(e.type) == e.size);
+		if (index + name_size > index_end || e.offset + e.size > mapping_size || !valid_pixels)
+		{
+			close();
+			return false;
+		}
+		entries[string(reinterpret_cast<const char *>(index), name_size)] = e;
+		index += name_size;
+	}
+
+	// the index is read in sequence, the content is accessed at random
+	madvise(mapping, mapping_size, MADV_RANDOM);
+	return true;
+}
+
+bool dataset_pack::is_open() const
+{
+	return mapping != nullptr;
+}
+
+bool dataset_pack::contains(const string &name) const
+{
+	return entries.count(name) > 0;
+}
+
+bool dataset_pack::get_bytes(const string &name, const uchar *&data, size_t &size) const
+{
+	auto found = entries.find(name);
+	if (found == entries.end() || found->second.kind != 0)
+		return false;
+	data = mapping + found->second.offset;
+	size = found->second.size;
+	return true;
+}
+
+Mat dataset_pack::get_image(const string &name, int flags) const
+{
+	auto found = entries.find(name);
+	if (found == entries.end())
+		return Mat();
+
+	const entry &e = found->second;
+	uchar *data = mapping + e.offset;
+	if (e.kind == 0)
+		return imdecode(Mat(1, static_cast<int>(e.size), CV_8U, data), flags);
+
+	// raw pixels are used in place, converted only if the stored channels do not match
+	Mat img(e.rows, e.cols, e.type, data);
+	int channels = img.channels();
+	if (flags == IMREAD_GRAYSCALE && channels != 1)
+	{
+		Mat gray;
+		cvtColor(img, gray, channels == 4 ? COLOR_BGRA2GRAY : COLOR_BGR2GRAY);
+		return gray;
+	}
+	if (flags == IMREAD_COLOR && channels != 3)
+	{
+		Mat color;
+		cvtColor(img, color, channels == 4 ? COLOR_BGRA2BGR : COLOR_GRAY2BGR);
+		return color;
+	}
+	return img;
+}
+
+vector<string> dataset_pack::list(const string &dir) const
+{
+	string prefix = dir.empty() || dir.back() == '/' ? dir : dir + "/";
+	vector<string> names;
+	for (auto it = entries.lower_bound(prefix); it != entries.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+	{
+		if (it->first.find('/', prefix.size()) == string::npos)
+			names.push_back(it->first.substr(prefix.size()));
+	}
+	return names;
+}
+
+vector<string> dataset_pack::list_dirs(const string &dir) const
+{
+	string prefix = dir.empty() || dir.back() == '/' ? dir : dir + "/";
+	vector<string> names;
+	for (auto it = entries.lower_bound(prefix); it != entries.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+	{
+		size_t slash = it->first.find('/', prefix.size());
+		if (slash == string::npos)
+			continue;
+		string name = it->first.substr(prefix.size(), slash - prefix.size());
+		// the files of a directory are contiguous, a name is repeated only by consecutive entries
+		if (names.empty() || names.back() != name)
+			names.push_back(name);
+	}
+	// "a-b/" sorts before "a/", so the directory names themselves may be out of order
+	sort(names.begin(), names.end());
+	return names;
+}
+
+// pack the dataset is read from, if open, and its path
+static dataset_pack pack;
+static string pack_path_opened;
+
+bool open_dataset_pack(const string &pack_path)
+{
+	if (!pack.open(pack_path))
+		return false;
+	pack_path_opened = pack_path;
+	return true;
+}
+
+bool dataset_pack_open()
+{
+	return pack.is_open();
+}
+
+string dataset_pack_path()
+{
+	return pack.is_open() ? pack_path_opened : string();
+}
+
+void glob_dataset(const string &pattern, vector<String> &result)
+{
+	if (!pack.is_open())
+	{
+		glob(pattern, result, false);
+		return;
+	}
+
+	// <dir>/<prefix>*<suffix>
+	size_t slash = pattern.find_last_of('/');
+	string dir = pattern.substr(0, slash);
+	string file_pattern = pattern.substr(slash + 1);
+	size_t star = file_pattern.find('*');
+	string prefix = file_pattern.substr(0, star);
+	string suffix = star == string::npos ? "" : file_pattern.substr(star + 1);
+
+	result.clear();
+	for (const string &file : pack.list(pack_name(dir)))
+	{
+		bool matches = star == string::npos ? file == file_pattern
+											: file.size() >= prefix.size() + suffix.size() && file.compare(0, prefix.size(), prefix) == 0 &&
+												  file.compare(file.size() - suffix.size(), suffix.size(), suffix) == 0;
+		if (matches)
+			result.push_back(dir + "/" + file);
+	}
+}
+
+vector<string> list_dataset(const string &dir)
+{
+	vector<string> paths;
+	if (pack.is_open())
+	{
+		for (const string &file : pack.list(pack_name(dir)))
+			paths.push_back(dir + "/" + file);
+		return paths;
+	}
+
+	for (const auto &file : fs::directory_iterator(dir))
+	{
+		if (file.is_regular_file())
+			paths.push_back(dir + "/" + file.path().filename().string());
+	}
+	sort(paths.begin(), paths.end());
+	return paths;
+}
+
+vector<string> list_dataset_dirs(const string &dir)
+{
+	vector<string> paths;
+	if (pack.is_open())
+	{
+		for (const string &name : pack.list_dirs(pack_name(dir)))
+			paths.push_back(dir + "/" + name);
+		return paths;
+	}
+
+	if (!fs::is_directory(dir))
+		return paths;
+	for (const auto &entry : fs::directory_iterator(dir))
+	{
+		if (entry.is_directory())
+			paths.push_back(dir + "/" + entry.path().filename().string());
+	}
+	sort(paths.begin(), paths.end());
+	return paths;
+}
+
+Mat read_dataset_image(const string &path, int flags)
+{
+	if (pack.is_open())
+		return pack.get_image(pack_name(path), flags);
+	return imread(path, flags);
+}
+
+bool read_dataset_bytes(const string &path, const uchar *&data, size_t &size)
+{
+	return pack.is_open() && pack.get_bytes(pack_name(path), data, size);
+}
+
+bool read_dataset_text(const string &path, string &text)
+{
+	if (pack.is_open())
+	{
+		const uchar *data;
+		size_t size;
+		if (!pack.get_bytes(pack_name(path), data, size))
+			return false;
+		text.assign(reinterpret_cast<const char *>(data), size);
+		return true;
+	}
+
+	ifstream file(path, ios::binary);
+	if (!file.is_open())
+		return false;
+	stringstream content;
+	content << file.rdbuf();
+	text = content.str();
+	return true;
+}
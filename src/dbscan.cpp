@@ -1,6 +1,7 @@
 // created by Davide Baggio 2122547
 
 #include "dbscan.hpp"
+#include <climits>
 
 float euclidean_dist(const Point &a, const Point &b)
 {
@@ -92,26 +93,113 @@ cluster_result dbscan(const vector<Point> &points, float eps, int min_points)
 	return result;
 }
 
-Rect get_dense_cluster(const vector<Point> &points, float eps = 30.0, int min_points = 5)
+/*
+ * Fills `neighbors` with the indices of the points within `eps` of point `idx` and returns their total weight.
+ */
+static float weighted_region_query(const weighted_points &input, int idx, float eps, vector<int> &neighbors)
 {
-	cluster_result result = dbscan(points, eps, min_points);
+	neighbors.clear();
+	float weight = 0.0f;
+	const Point &center = input.points[idx];
+	for (int i = 0; i < static_cast<int>(input.size()); ++i)
+	{
+		if (euclidean_dist(center, input.points[i]) <= eps)
+		{
+			neighbors.push_back(i);
+			weight += input.weights[i];
+		}
+	}
+	return weight;
+}
+
+cluster_quality get_weighted_cluster(const weighted_points &input, float eps, float min_weight)
+{
+	const int unvisited = 0;
+	const int noise = -1;
 
-	if (result.clusters.empty())
-		return Rect();
+	cluster_quality quality;
+	quality.total_points = input.size();
+
+	// scratch buffers of the calling thread, reused across frames
+	static thread_local vector<int> labels;
+	static thread_local vector<int> seeds;
+	static thread_local vector<int> neighbors;
+	static thread_local vector<float> cluster_weights;
+	labels.assign(input.size(), unvisited);
+	cluster_weights.clear();
+
+	float total_weight = 0.0f;
+	for (float w : input.weights)
+		total_weight += w;
+
+	int cluster_id = 0;
+	for (int i = 0; i < static_cast<int>(input.size()); ++i)
+	{
+		if (labels[i] != unvisited)
+			continue;
+		if (weighted_region_query(input, i, eps, seeds) < min_weight)
+		{
+			labels[i] = noise;
+			continue;
+		}
 
-	size_t max_size = 0;
-	vector<Point> *densest = nullptr;
+		cluster_id++;
+		labels[i] = cluster_id;
+		float weight = input.weights[i];
+		for (size_t k = 0; k < seeds.size(); ++k)
+		{
+			int current = seeds[k];
+			if (labels[current] == noise)
+			{
+				labels[current] = cluster_id;
+				weight += input.weights[current];
+			}
+			else if (labels[current] == unvisited)
+			{
+				labels[current] = cluster_id;
+				weight += input.weights[current];
+				if (weighted_region_query(input, current, eps, neighbors) >= min_weight)
+					seeds.insert(seeds.end(), neighbors.begin(), neighbors.end());
+			}
+		}
+		cluster_weights.push_back(weight);
+	}
 
-	for (auto &cluster : result.clusters)
+	// heaviest cluster, the first one on ties
+	int densest = 0;
+	for (int c = 0; c < static_cast<int>(cluster_weights.size()); ++c)
 	{
-		if (cluster.size() > max_size)
+		if (cluster_weights[c] > quality.cluster_weight)
 		{
-			max_size = cluster.size();
-			densest = &cluster;
+			quality.cluster_weight = cluster_weights[c];
+			densest = c + 1;
 		}
 	}
+	if (densest == 0)
+		return quality;
 
-	return boundingRect(*densest);
+	int x_min = INT_MAX, y_min = INT_MAX, x_max = INT_MIN, y_max = INT_MIN;
+	for (size_t i = 0; i < input.size(); ++i)
+	{
+		if (labels[i] != densest)
+			continue;
+		const Point &pt = input.points[i];
+		x_min = min(x_min, pt.x);
+		y_min = min(y_min, pt.y);
+		x_max = max(x_max, pt.x);
+		y_max = max(y_max, pt.y);
+		quality.cluster_size++;
+	}
+
+	// same convention as boundingRect, the box includes its last row and column
+	quality.box = Rect(x_min, y_min, x_max - x_min + 1, y_max - y_min + 1);
+	quality.concentration = total_weight > 0.0f ? quality.cluster_weight / total_weight : 0.0f;
+	return quality;
+}
+
+Rect get_dense_cluster(const weighted_points &input, float eps, float min_weight)
+{
+	return get_weighted_cluster(input, eps, min_weight).box;
 }
 
 void draw_cluster(const vector<Point> &points, const cluster_result &result, const Rect &densest_box)
@@ -0,0 +1,134 @@
+// created by Davide Baggio 2122547
+
+#include "descriptor_codec.hpp"
+#include <set>
+
+bool parse_descriptor_mode(const string &name, descriptor_mode &mode, int &dims)
+{
+	dims = 0;
+	if (name == "float")
+		mode = DESCRIPTOR_FLOAT;
+	else if (name == "uint8")
+		mode = DESCRIPTOR_UINT8;
+	else if (name == "pca32" || name == "pca64")
+	{
+		mode = DESCRIPTOR_PCA;
+		dims = stoi(name.substr(3));
+	}
+	else
+		return false;
+	return true;
+}
+
+descriptor_codec::descriptor_codec(descriptor_mode mode, int dims)
+{
+	this->mode = mode;
+	this->dims = mode == DESCRIPTOR_PCA ? dims : 0;
+}
+
+bool descriptor_codec::compact() const
+{
+	return mode != DESCRIPTOR_FLOAT;
+}
+
+string descriptor_codec::name() const
+{
+	if (mode == DESCRIPTOR_UINT8)
+		return "uint8";
+	if (mode == DESCRIPTOR_PCA)
+		return "pca" + to_string(dims);
+	return "float";
+}
+
+void descriptor_codec::train(const vector<vector<Mat>> &model_descriptors)
+{
+	if (mode != DESCRIPTOR_PCA)
+		return;
+
+	Mat data;
+	for (const vector<Mat> &views : model_descriptors)
+	{
+		for (const Mat &view : views)
+		{
+			if (!view.empty())
+				data.push_back(view);
+		}
+	}
+	if (data.rows <= dims)
+	{
+		cerr << "[ERROR]: not enough model descriptors to fit " << dims << " principal components" << endl;
+		mode = DESCRIPTOR_FLOAT;
+		dims = 0;
+		return;
+	}
+	pca = PCA(data, Mat(), PCA::DATA_AS_ROW, dims);
+}
+
+Mat descriptor_codec::encode(const Mat &descriptors) const
+{
+	if (descriptors.empty())
+		return descriptors;
+
+	Mat encoded;
+	if (mode == DESCRIPTOR_UINT8)
+		descriptors.convertTo(encoded, CV_8U);
+	else if (mode == DESCRIPTOR_PCA)
+		pca.project(descriptors, encoded);
+	else
+		encoded = descriptors;
+	return encoded;
+}
+
+void descriptor_codec::knn_match(const Mat &model_desc, const Mat &img_desc, vector<vector<DMatch>> &matches, int k) const
+{
+	// the brute force matcher works on the rows as stored: 8 bit integers or reduced floats
+	BFMatcher matcher(NORM_L2);
+	matcher.knnMatch(model_desc, img_desc, matches, k);
+}
+
+/*
+ * Returns the (model, frame) index pairs of the 2-NN matches that pass the ratio test.
+ */
+static set<pair<int, int>> ratio_matches(const vector<vector<DMatch>> &knn_matches, float ratio)
+{
+	set<pair<int, int>> good;
+	for (const auto &m : knn_matches)
+	{
+		if (m.size() == 2 && m[0].distance < ratio * m[1].distance)
+			good.insert({m[0].queryIdx, m[0].trainIdx});
+	}
+	return good;
+}
+
+float descriptor_codec::measure_recall(const vector<vector<Mat>> &model_descriptors, float ratio, int max_pairs) const
+{
+	size_t reference_total = 0;
+	size_t kept_total = 0;
+	int pairs = 0;
+	BFMatcher exact(NORM_L2);
+
+	for (size_t i = 0; i < model_descriptors.size() && pairs < max_pairs; i++)
+	{
+		for (size_t j = 0; j + 1 < model_descriptors[i].size() && pairs < max_pairs; j += 2)
+		{
+			const Mat &model = model_descriptors[i][j];
+			const Mat &img = model_descriptors[i][j + 1];
+			if (model.rows < 2 || img.rows < 2)
+				continue;
+
+			vector<vector<DMatch>> knn_matches;
+			exact.knnMatch(model, img, knn_matches, 2);
+			set<pair<int, int>> reference = ratio_matches(knn_matches, ratio);
+
+			knn_match(encode(model), encode(img), knn_matches, 2);
+			set<pair<int, int>> compact_matches = ratio_matches(knn_matches, ratio);
+
+			for (const auto &m : reference)
+				kept_total += compact_matches.count(m);
+			reference_total += reference.size();
+			pairs++;
+		}
+	}
+
+	return reference_total == 0 ? 1.0f : static_cast<float>(kept_total) / reference_total;
+}
@@ -1,6 +1,9 @@
 // created by Davide Baggio 2122547
 
 #include "detection.hpp"
+#include "dataset_pack.hpp"
+#include "category_table.hpp"
+#include <sstream>
 
 string get_filename(string path)
 {
@@ -8,6 +11,75 @@ string get_filename(string path)
 	return filename.substr(0, filename.find_last_of("-"));
 }
 
+string get_label_path(string image_path)
+{
+	string dir = image_path.substr(0, image_path.find_last_of("/"));
+	dir = dir.substr(0, dir.find_last_of("/") + 1);
+	return dir + label_path + get_filename(image_path) + "-box.txt";
+}
+
+map<string, Rect> read_boxes(string path)
+{
+	map<string, Rect> boxes;
+	string text;
+	if (!read_dataset_text(path, text))
+		return boxes;
+	istringstream file(text);
+
+	string name;
+	int x1, y1, x2, y2;
+	while (file >> name >> x1 >> y1 >> x2 >> y2)
+	{
+		boxes[name] = Rect(x1, y1, x2 - x1, y2 - y1);
+	}
+	return boxes;
+}
+
+void detection_score::add(float iou)
+{
+	total++;
+	iou_total += iou;
+	if (iou > 0.5)
+		detected++;
+}
+
+float detection_score::average_iou() const
+{
+	return total > 0 ? iou_total / static_cast<float>(total) : 0.0f;
+}
+
+void score_frame(const map<string, Rect> &labels, const vector<string> &names, const vector<Rect> &boxes, detection_score &score)
+{
+	for (size_t c = 0; c < names.size() && c < boxes.size(); c++)
+	{
+		auto label = labels.find(names[c]);
+		if (label == labels.end())
+			continue;
+		score.add(intersection_over_union(label->second, boxes[c]));
+	}
+}
+
+bool parse_cascade_type(const string &name, cascade_type &type)
+{
+	if (name == "haar")
+		type = CASCADE_HAAR;
+	else if (name == "lbp")
+		type = CASCADE_LBP;
+	else
+		return false;
+	return true;
+}
+
+string get_cascade_type_name(cascade_type type)
+{
+	return type == CASCADE_LBP ? "lbp" : "haar";
+}
+
+string get_cascade_path(const string &category, cascade_type type)
+{
+	return base + category + (type == CASCADE_LBP ? cascade_lbp : cascade);
+}
+
 bool is_yellow(Vec3b pixel)
 {
 	return (pixel[0] < 30 && pixel[1] > 90 && pixel[2] > 90);
@@ -41,19 +113,66 @@ float intersection_over_union(Rect rect1, Rect rect2)
 	return intersection_area / union_area;
 }
 
-void display_performances()
+/*
+ * Scores the aggregated annotations of the last run against the labels, reading them with one sequential scan.
+ */
+static void display_aggregated_performances(const vector<String> &true_labels)
 {
-	vector<String> tested_annotations;
-	glob("output/*.txt", tested_annotations, false);
+	map<string, map<string, Rect>> tested_frames;
+	if (!read_annotations("output/" + annotations_file, tested_frames))
+	{
+		cerr << "[ERROR]: Could not open output/" << annotations_file << "." << endl;
+		return;
+	}
 
-	vector<String> true_labels, true_label_s, true_label_m, true_label_d;
-	glob(base + sugar + label_path + "*.txt", true_label_s, false);
-	glob(base + mustard + label_path + "*.txt", true_label_m, false);
-	glob(base + drill + label_path + "*.txt", true_label_d, false);
+	int obj_detected_num = 0;
+	int obj_total = 0;
+	float iou_total = 0;
+	for (size_t i = 0; i < true_labels.size(); i++)
+	{
+		auto tested = tested_frames.find(get_filename(true_labels[i]));
+		if (tested == tested_frames.end())
+			continue;
 
-	true_labels.insert(true_labels.end(), true_label_s.begin(), true_label_s.end());
-	true_labels.insert(true_labels.end(), true_label_m.begin(), true_label_m.end());
-	true_labels.insert(true_labels.end(), true_label_d.begin(), true_label_d.end());
+		for (const auto &label : read_boxes(true_labels[i]))
+		{
+			auto tested_box = tested->second.find(label.first);
+			if (tested_box == tested->second.end())
+				continue;
+
+			obj_total++;
+			float IoU = intersection_over_union(label.second, tested_box->second);
+			iou_total += IoU;
+			cout << get_filename(true_labels[i]) << " - " << label.first << " -> IoU: " << IoU << endl;
+			if (IoU > 0.5)
+			{
+				obj_detected_num++;
+			}
+		}
+	}
+
+	cout << "Total objects detected: " << obj_detected_num << "/" << obj_total << endl;
+	cout << "Average IoU: " << iou_total / static_cast<float>(obj_total) << endl;
+}
+
+void display_performances(annotation_format format)
+{
+	vector<String> true_labels;
+	for (const category_info &category : get_categories())
+	{
+		vector<String> category_labels;
+		glob_dataset(base + category.folder + label_path + "*.txt", category_labels);
+		true_labels.insert(true_labels.end(), category_labels.begin(), category_labels.end());
+	}
+
+	if (format == ANNOTATIONS_JSONL)
+	{
+		display_aggregated_performances(true_labels);
+		return;
+	}
+
+	vector<String> tested_annotations;
+	glob("output/*.txt", tested_annotations, false);
 
 	int obj_detected_num = 0;
 	int obj_total = 0;
@@ -65,10 +184,13 @@ void display_performances()
 			if (get_filename(true_labels[i]) != get_filename(tested_annotations[j]))
 				continue;
 
-			ifstream label_file(true_labels[i]);
+			// labels come from the dataset, the tested annotations from the output directory
+			string label_text;
+			bool label_read = read_dataset_text(true_labels[i], label_text);
+			istringstream label_file(label_text);
 			ifstream tested_file(tested_annotations[j]);
 
-			if (!label_file.is_open() || !tested_file.is_open())
+			if (!label_read || !tested_file.is_open())
 			{
 				cerr << "[ERROR]: Could not open label or tested file." << endl;
 				return;
@@ -115,7 +237,6 @@ void display_performances()
 				tested_file.clear();
 				tested_file.seekg(0, ios::beg);
 			}
-			label_file.close();
 			tested_file.close();
 		}
 	}
@@ -0,0 +1,227 @@
+// created by Davide Baggio 2122547
+
+#include "detection_api.h"
+#include "frame_processing.hpp"
+#include "category_table.hpp"
+#include "dataset_pack.hpp"
+#include "detection.hpp"
+#include <memory>
+#include <mutex>
+#include <new>
+
+/*
+ * Models and per-frame buffers of a context, allocated once by `detection_create`.
+ */
+struct detection_context
+{
+	pipeline_config config;
+	unique_ptr<detector_set> detectors;
+	unique_ptr<frame_context> ctx;
+	vector<string> category_names;
+
+	// boxes of the last frame and frame converted to BGR when given in another format
+	vector<Rect> boxes;
+	Mat converted;
+};
+
+/*
+ * Fills the pipeline options of a context from the options of the interface.
+ */
+static bool make_config(const detection_options &options, pipeline_config &config)
+{
+	if (!(options.scale > 0.0f && options.scale <= 1.0f) || options.roi_expand < 0.0f || options.feature_budget_ms < 0.0 ||
+		options.max_keypoints <= 0 || options.candidate_views < 0 || options.tile_size < 0 || options.tile_halo < 0)
+		return false;
+
+	config.scale = options.scale;
+	config.roi_expand = options.roi_expand;
+	config.refine = options.refine != 0;
+	config.feature_budget_ms = options.feature_budget_ms;
+	config.max_keypoints = options.max_keypoints;
+	config.candidate_views = options.candidate_views;
+	config.shared_views = options.shared_views != 0;
+	config.bounded_views = options.bounded_views != 0;
+	config.tile_size = options.tile_size;
+	config.tile_halo = options.tile_halo;
+	config.parallel_categories = options.parallel != 0;
+	config.parallel_views = options.parallel != 0;
+	config.frame_log = false;
+	return true;
+}
+
+/*
+ * Returns a header on the pixels of a frame, or converts them into `converted` if they are not BGR.
+ */
+static bool wrap_frame(const detection_frame &frame, Mat &converted, Mat &img)
+{
+	const int types[] = {CV_8UC3, CV_8UC3, CV_8UC4, CV_8UC4, CV_8UC1};
+	const int conversions[] = {-1, COLOR_RGB2BGR, COLOR_BGRA2BGR, COLOR_RGBA2BGR, COLOR_GRAY2BGR};
+	if (frame.data == nullptr || frame.width <= 0 || frame.height <= 0 || frame.format < DETECTION_FORMAT_BGR ||
+		frame.format > DETECTION_FORMAT_GRAY)
+		return false;
+
+	int type = types[frame.format];
+	size_t row_bytes = static_cast<size_t>(frame.width) * CV_ELEM_SIZE(type);
+	size_t stride = frame.stride == 0 ? row_bytes : frame.stride;
+	if (stride < row_bytes)
+		return false;
+
+	Mat pixels(frame.height, frame.width, type, const_cast<unsigned char *>(frame.data), stride);
+	if (conversions[frame.format] < 0)
+		img = pixels;
+	else
+	{
+		// the buffer of the context keeps its memory across frames of the same size
+		cvtColor(pixels, converted, conversions[frame.format]);
+		img = converted;
+	}
+	return true;
+}
+
+extern "C"
+{
+	void detection_default_options(detection_options *options)
+	{
+		if (options == nullptr)
+			return;
+		pipeline_config defaults;
+		options->scale = defaults.scale;
+		options->roi_expand = defaults.roi_expand;
+		options->refine = defaults.refine;
+		options->feature_budget_ms = defaults.feature_budget_ms;
+		options->max_keypoints = defaults.max_keypoints;
+		options->candidate_views = defaults.candidate_views;
+		options->shared_views = defaults.shared_views;
+		options->bounded_views = defaults.bounded_views;
+		options->tile_size = defaults.tile_size;
+		options->tile_halo = defaults.tile_halo;
+		options->parallel = defaults.parallel_categories && defaults.parallel_views;
+	}
+
+	detection_status detection_create(const char *dataset_pack, const detection_options *options, detection_context **context)
+	{
+		if (context == nullptr)
+			return DETECTION_ERROR_ARGUMENT;
+		*context = nullptr;
+
+		detection_options given;
+		detection_default_options(&given);
+		if (options != nullptr)
+			given = *options;
+
+		try
+		{
+			unique_ptr<detection_context> created(new detection_context());
+			if (!make_config(given, created->config))
+				return DETECTION_ERROR_ARGUMENT;
+
+			{
+				// the dataset is opened once per process, before the categories are discovered in it, and the
+				// contexts created after must read the same one
+				static mutex dataset_lock;
+				lock_guard<mutex> guard(dataset_lock);
+				string requested = dataset_pack != nullptr ? dataset_pack : string();
+				if (dataset_pack_open() ? requested != dataset_pack_path() : (!requested.empty() && categories_discovered()))
+					return DETECTION_ERROR_ARGUMENT;
+				if (!requested.empty() && !dataset_pack_open() && !open_dataset_pack(requested))
+					return DETECTION_ERROR_LOAD;
+				if (get_num_categories() == 0)
+					return DETECTION_ERROR_LOAD;
+			}
+
+			created->detectors.reset(new detector_set());
+			if (!configure_detectors(created->config, *created->detectors))
+				return DETECTION_ERROR_LOAD;
+
+			created->category_names = get_category_names();
+			int num_categories = static_cast<int>(created->category_names.size());
+			created->ctx.reset(new frame_context(num_categories, created->config));
+			created->boxes.resize(num_categories);
+
+			*context = created.release();
+			return DETECTION_OK;
+		}
+		catch (const bad_alloc &)
+		{
+			return DETECTION_ERROR_MEMORY;
+		}
+		catch (...)
+		{
+			return DETECTION_ERROR_INTERNAL;
+		}
+	}
+
+	void detection_destroy(detection_context *context)
+	{
+		delete context;
+	}
+
+	int detection_num_categories(const detection_context *context)
+	{
+		return context == nullptr ? 0 : static_cast<int>(context->category_names.size());
+	}
+
+	const char *detection_category_name(const detection_context *context, int category)
+	{
+		if (context == nullptr || category < 0 || category >= static_cast<int>(context->category_names.size()))
+			return nullptr;
+		return context->category_names[category].c_str();
+	}
+
+	detection_status detection_detect(detection_context *context, const detection_frame *frame, detection_box *boxes, int capacity)
+	{
+		if (context == nullptr || frame == nullptr || boxes == nullptr)
+			return DETECTION_ERROR_ARGUMENT;
+		int num_categories = static_cast<int>(context->boxes.size());
+		if (capacity < num_categories)
+			return DETECTION_ERROR_CAPACITY;
+
+		try
+		{
+			Mat img;
+			if (!wrap_frame(*frame, context->converted, img))
+				return DETECTION_ERROR_ARGUMENT;
+
+			detect_frame(context->detectors->pipeline, img, context->config, *context->ctx, context->boxes);
+			for (int c = 0; c < num_categories; c++)
+			{
+				const Rect &box = context->boxes[c];
+				boxes[c].category = c;
+				boxes[c].found = box.empty() ? 0 : 1;
+				boxes[c].x = box.x;
+				boxes[c].y = box.y;
+				boxes[c].width = box.width;
+				boxes[c].height = box.height;
+			}
+			return DETECTION_OK;
+		}
+		catch (const bad_alloc &)
+		{
+			return DETECTION_ERROR_MEMORY;
+		}
+		catch (...)
+		{
+			return DETECTION_ERROR_INTERNAL;
+		}
+	}
+
+	const char *detection_status_message(detection_status status)
+	{
+		switch (status)
+		{
+		case DETECTION_OK:
+			return "success";
+		case DETECTION_ERROR_ARGUMENT:
+			return "invalid argument";
+		case DETECTION_ERROR_LOAD:
+			return "the dataset, the categories or a cascade cannot be loaded";
+		case DETECTION_ERROR_CAPACITY:
+			return "the box array is smaller than the number of categories";
+		case DETECTION_ERROR_MEMORY:
+			return "out of memory";
+		case DETECTION_ERROR_INTERNAL:
+			return "internal error";
+		}
+		return "unknown status";
+	}
+}
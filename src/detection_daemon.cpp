@@ -0,0 +1,355 @@
+// created by Davide Baggio 2122547
+
+#include "detection_daemon.hpp"
+#include "annotation_output.hpp"
+#include "detection.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// bytes read from a connection at once
+const static size_t daemon_read_chunk = 64 << 10;
+
+// longest request line accepted
+const static size_t daemon_max_line = 4096;
+
+/*
+ * Reads the requests of a connection, keeping what was read past the current request for the next one.
+ */
+struct connection_reader
+{
+	int fd;
+	string pending;
+
+	/*
+	 * Reads more bytes from the connection, returns false if it is closed.
+	 */
+	bool fill()
+	{
+		char chunk[daemon_read_chunk];
+		ssize_t count = recv(fd, chunk, sizeof(chunk), 0);
+		if (count <= 0)
+			return false;
+		pending.append(chunk, static_cast<size_t>(count));
+		return true;
+	}
+
+	/*
+	 * Reads a line without its newline, returns false if the connection is closed first or the line is too long.
+	 */
+	bool read_line(string &line)
+	{
+		size_t end;
+		while ((end = pending.find('\n')) == string::npos)
+		{
+			if (pending.size() > daemon_max_line || !fill())
+				return false;
+		}
+		line.assign(pending, 0, end);
+		pending.erase(0, end + 1);
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		return true;
+	}
+
+	/*
+	 * Reads exactly `size` bytes, returns false if the connection is closed first.
+	 */
+	bool read_bytes(size_t size, vector<uchar> &bytes)
+	{
+		bytes.resize(size);
+		size_t copied = min(size, pending.size());
+		memcpy(bytes.data(), pending.data(), copied);
+		pending.erase(0, copied);
+		while (copied < size)
+		{
+			ssize_t count = recv(fd, bytes.data() + copied, size - copied, 0);
+			if (count <= 0)
+				return false;
+			copied += static_cast<size_t>(count);
+		}
+		return true;
+	}
+};
+
+/*
+ * Writes a whole reply, without raising SIGPIPE if the client is gone.
+ */
+static bool send_reply(int fd, const string &reply)
+{
+	size_t sent = 0;
+	while (sent < reply.size())
+	{
+		ssize_t count = send(fd, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+		if (count <= 0)
+			return false;
+		sent += static_cast<size_t>(count);
+	}
+	return true;
+}
+
+static string error_reply(const string &message)
+{
+	return "{\"error\":\"" + message + "\"}\n";
+}
+
+/*
+ * Worker taken from the free ones for a request, given back when the request ends even if the handler throws.
+ */
+struct worker_lease
+{
+	vector<int> &free_workers;
+	mutex &worker_lock;
+	condition_variable &worker_ready;
+	int worker;
+
+	worker_lease(vector<int> &free_workers, mutex &worker_lock, condition_variable &worker_ready)
+		: free_workers(free_workers), worker_lock(worker_lock), worker_ready(worker_ready)
+	{
+		unique_lock<mutex> guard(worker_lock);
+		worker_ready.wait(guard, [&]()
+						  { return !free_workers.empty(); });
+		worker = free_workers.back();
+		free_workers.pop_back();
+	}
+
+	~worker_lease()
+	{
+		{
+			lock_guard<mutex> guard(worker_lock);
+			free_workers.push_back(worker);
+		}
+		worker_ready.notify_one();
+	}
+};
+
+detection_daemon::detection_daemon(const string &socket_path, int workers, const vector<string> &category_names) : socket_path(socket_path), category_names(category_names)
+{
+	for (int w = 0; w < max(workers, 1); w++)
+		free_workers.push_back(w);
+}
+
+detection_daemon::~detection_daemon()
+{
+	if (listen_fd >= 0)
+	{
+		close(listen_fd);
+		unlink(socket_path.c_str());
+	}
+}
+
+bool detection_daemon::run(const frame_handler &handler)
+{
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socket_path.size() >= sizeof(address.sun_path))
+	{
+		cerr << "[ERROR]: socket path too long " << socket_path << endl;
+		return false;
+	}
+	strcpy(address.sun_path, socket_path.c_str());
+
+	listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(socket_path.c_str());
+	if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(listen_fd, SOMAXCONN) != 0)
+	{
+		cerr << "[ERROR]: could not listen on " << socket_path << ": " << strerror(errno) << endl;
+		return false;
+	}
+
+	start_ticks = getTickCount();
+	cout << "[INFO]: Listening on " << socket_path << " with " << free_workers.size() << " workers" << endl;
+	while (true)
+	{
+		int fd = accept(listen_fd, nullptr, nullptr);
+		if (fd < 0)
+		{
+			// the listening socket is shut down by a shutdown request
+			lock_guard<mutex> guard(connection_lock);
+			if (stopping)
+				break;
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			cerr << "[ERROR]: accept failed: " << strerror(errno) << endl;
+			break;
+		}
+
+		lock_guard<mutex> guard(connection_lock);
+		if (stopping)
+		{
+			close(fd);
+			break;
+		}
+		// the threads are detached so a long running daemon keeps none of the finished ones
+		connections.insert(fd);
+		thread(&detection_daemon::serve, this, fd, cref(handler)).detach();
+	}
+
+	stop();
+	{
+		unique_lock<mutex> guard(connection_lock);
+		connection_closed.wait(guard, [&]()
+							   { return connections.empty(); });
+	}
+
+	close(listen_fd);
+	listen_fd = -1;
+	unlink(socket_path.c_str());
+	return true;
+}
+
+void detection_daemon::stop()
+{
+	lock_guard<mutex> guard(connection_lock);
+	stopping = true;
+	shutdown(listen_fd, SHUT_RDWR);
+
+	// connections waiting for a request are closed, the ones processing a request still send their reply
+	for (int fd : connections)
+		shutdown(fd, SHUT_RD);
+}
+
+void detection_daemon::serve(int fd, const frame_handler &handler)
+{
+	connection_reader reader{fd, string()};
+	daemon_request request;
+	vector<Rect> boxes;
+	string line;
+	string reply;
+
+	while (reader.read_line(line))
+	{
+		string command = line.substr(0, line.find(' '));
+		string argument = line.size() > command.size() ? line.substr(command.size() + 1) : string();
+
+		if (command == "path" && !argument.empty())
+		{
+			request.path = argument;
+			request.image.clear();
+			detect(request, handler, boxes, reply);
+		}
+		else if (command == "image")
+		{
+			char *end;
+			unsigned long long size = strtoull(argument.c_str(), &end, 10);
+			if (argument.empty() || *end != '\0' || size == 0 || size > daemon_max_image_bytes)
+			{
+				// the image bytes cannot be skipped without a valid size, the connection is closed
+				send_reply(fd, error_reply("invalid image size"));
+				break;
+			}
+			request.path.clear();
+			if (!reader.read_bytes(static_cast<size_t>(size), request.image))
+				break;
+			detect(request, handler, boxes, reply);
+		}
+		else if (command == "stats")
+			reply = format_stats();
+		else if (command == "shutdown")
+		{
+			send_reply(fd, "{\"shutdown\":true}\n");
+			stop();
+			break;
+		}
+		else
+			reply = error_reply("unknown request");
+
+		if (!send_reply(fd, reply))
+			break;
+	}
+
+	// the last access to the daemon, it may return from `run` as soon as the lock is released
+	lock_guard<mutex> guard(connection_lock);
+	close(fd);
+	connections.erase(fd);
+	connection_closed.notify_all();
+}
+
+void detection_daemon::detect(const daemon_request &request, const frame_handler &handler, vector<Rect> &boxes, string &reply)
+{
+	int64 start = getTickCount();
+	{
+		lock_guard<mutex> guard(stats_lock);
+		stats.active++;
+	}
+
+	bool success = false;
+	double wait;
+	string error = "could not read the image";
+	{
+		worker_lease lease(free_workers, worker_lock, worker_ready);
+		wait = (getTickCount() - start) / getTickFrequency();
+
+		// an exception would terminate the detached thread of the connection, it fails the request instead
+		boxes.assign(category_names.size(), Rect());
+		try
+		{
+			success = handler(lease.worker, request, boxes);
+		}
+		catch (const exception &e)
+		{
+			cerr << "[ERROR]: request failed: " << e.what() << endl;
+			error = "could not process the image";
+		}
+		catch (...)
+		{
+			error = "could not process the image";
+		}
+	}
+
+	if (success)
+		format_annotation_line(request.path.empty() ? string("image") : get_filename(request.path), category_names, boxes, reply);
+	else
+		reply = error_reply(error);
+	record(success, (getTickCount() - start) / getTickFrequency(), wait);
+}
+
+void detection_daemon::record(bool success, double latency, double wait)
+{
+	lock_guard<mutex> guard(stats_lock);
+	stats.active--;
+	if (!success)
+	{
+		stats.failed++;
+		return;
+	}
+
+	stats.served++;
+	stats.total_latency += latency;
+	stats.total_wait += wait;
+	stats.max_latency = max(stats.max_latency, latency);
+	if (stats.recent.size() < daemon_latency_window)
+		stats.recent.push_back(latency);
+	else
+		stats.recent[stats.next_recent] = latency;
+	stats.next_recent = (stats.next_recent + 1) % daemon_latency_window;
+}
+
+string detection_daemon::format_stats() const
+{
+	lock_guard<mutex> guard(stats_lock);
+	double uptime = start_ticks > 0 ? (getTickCount() - start_ticks) / getTickFrequency() : 0.0;
+
+	vector<double> sorted = stats.recent;
+	sort(sorted.begin(), sorted.end());
+	auto percentile = [&](double p)
+	{ return sorted.empty() ? 0.0 : 1000.0 * sorted[static_cast<size_t>(p * (sorted.size() - 1))]; };
+	size_t served = max<size_t>(stats.served, 1);
+
+	return "{\"served\":" + to_string(stats.served) + ",\"failed\":" + to_string(stats.failed) +
+		   ",\"active\":" + to_string(stats.active) + ",\"uptime_s\":" + to_string(uptime) +
+		   ",\"frames_per_s\":" + to_string(stats.served / max(uptime, 1e-9)) +
+		   ",\"avg_ms\":" + to_string(1000.0 * stats.total_latency / served) + ",\"p50_ms\":" + to_string(percentile(0.5)) +
+		   ",\"p95_ms\":" + to_string(percentile(0.95)) + ",\"max_ms\":" + to_string(1000.0 * stats.max_latency) +
+		   ",\"avg_wait_ms\":" + to_string(1000.0 * stats.total_wait / served) + "}\n";
+}
+
+void detection_daemon::print_stats(ostream &out) const
+{
+	out << "[INFO]: daemon counters " << format_stats();
+}
@@ -0,0 +1,130 @@
+// created by Davide Baggio 2122547
+
+#include "detection_result.hpp"
+#include <iostream>
+
+frame_result::frame_result(int num_categories)
+{
+	this->num_categories = num_categories;
+	blocks.resize(DETECTOR_COUNT * num_categories);
+}
+
+void frame_result::clear()
+{
+	points.clear();
+	distances.clear();
+	categories.clear();
+	sources.clear();
+	fill(blocks.begin(), blocks.end(), block());
+	open_block = -1;
+	regions.clear();
+}
+
+void frame_result::reserve(size_t n)
+{
+	points.reserve(n);
+	distances.reserve(n);
+	categories.reserve(n);
+	sources.reserve(n);
+}
+
+void frame_result::begin_block(detector_id detector, int category)
+{
+	if (detector < 0 || detector >= DETECTOR_COUNT || category < 0 || category >= num_categories)
+	{
+		cout << "[ERROR]: invalid block for insertion\n";
+		return;
+	}
+	if (open_block >= 0)
+		end_block();
+
+	open_block = detector * num_categories + category;
+	blocks[open_block].offset = static_cast<uint32_t>(points.size());
+	blocks[open_block].count = 0;
+}
+
+void frame_result::push(const Point &pt, float distance)
+{
+	if (open_block < 0)
+		return;
+
+	points.push_back(pt);
+	distances.push_back(distance);
+	categories.push_back(static_cast<uint16_t>(open_block % num_categories));
+	sources.push_back(static_cast<uint8_t>(open_block / num_categories));
+	blocks[open_block].count++;
+}
+
+void frame_result::end_block()
+{
+	open_block = -1;
+}
+
+point_view frame_result::view(detector_id detector, int category) const
+{
+	if (detector < 0 || detector >= DETECTOR_COUNT || category < 0 || category >= num_categories)
+		return point_view();
+
+	const block &b = blocks[detector * num_categories + category];
+	if (b.count == 0)
+		return point_view();
+	return point_view(points.data() + b.offset, distances.data() + b.offset, b.count);
+}
+
+point_view frame_result::top(detector_id detector, int category, float perc) const
+{
+	return view(detector, category).top(perc);
+}
+
+void frame_result::rescale(float factor)
+{
+	for (Point &pt : points)
+	{
+		pt.x = cvRound(pt.x * factor);
+		pt.y = cvRound(pt.y * factor);
+	}
+	for (Rect &r : regions)
+	{
+		r = Rect(cvRound(r.x * factor), cvRound(r.y * factor), cvRound(r.width * factor), cvRound(r.height * factor));
+	}
+}
+
+vector<Rect> &frame_result::get_regions()
+{
+	return regions;
+}
+
+const vector<Rect> &frame_result::get_regions() const
+{
+	return regions;
+}
+
+size_t frame_result::size() const
+{
+	return points.size();
+}
+
+int frame_result::get_num_categories() const
+{
+	return num_categories;
+}
+
+const vector<Point> &frame_result::get_points() const
+{
+	return points;
+}
+
+const vector<float> &frame_result::get_distances() const
+{
+	return distances;
+}
+
+const vector<uint16_t> &frame_result::get_categories() const
+{
+	return categories;
+}
+
+const vector<uint8_t> &frame_result::get_sources() const
+{
+	return sources;
+}
@@ -0,0 +1,77 @@
+// created by Davide Baggio 2122547
+
+#include "feature_budget.hpp"
+
+feature_budget::feature_budget(double budget_ms, int max_keypoints)
+{
+	this->budget = budget_ms / 1000.0;
+	this->max_keypoints = max_keypoints;
+	this->min_keypoints = min(min_keypoints, max_keypoints);
+}
+
+bool feature_budget::enabled() const
+{
+	return budget > 0.0;
+}
+
+int feature_budget::limit() const
+{
+	if (!calibrated || keypoint_cost <= 0.0)
+		return max_keypoints;
+
+	double available = budget - detection_cost;
+	int fits = static_cast<int>(available / keypoint_cost);
+	return max(min_keypoints, min(max_keypoints, fits));
+}
+
+void feature_budget::select(vector<KeyPoint> &keypoints)
+{
+	frames++;
+	detected_total += keypoints.size();
+
+	if (!enabled() || keypoints.empty())
+	{
+		kept_total += keypoints.size();
+		return;
+	}
+
+	float strongest = 0.0f;
+	for (const KeyPoint &kp : keypoints)
+		strongest = max(strongest, kp.response);
+
+	int content_limit = 0;
+	for (const KeyPoint &kp : keypoints)
+	{
+		if (kp.response >= response_ratio * strongest)
+			content_limit++;
+	}
+
+	int keep = min(limit(), max(content_limit, min_keypoints));
+	if (keep < static_cast<int>(keypoints.size()))
+		KeyPointsFilter::retainBest(keypoints, keep);
+	kept_total += keypoints.size();
+}
+
+void feature_budget::record_detection(double seconds)
+{
+	last_detection = seconds;
+	detection_cost = calibrated ? (1.0 - smoothing) * detection_cost + smoothing * seconds : seconds;
+}
+
+void feature_budget::record_frame(size_t keypoints, double seconds)
+{
+	if (keypoints == 0)
+		return;
+
+	double cost = max(0.0, seconds - last_detection) / static_cast<double>(keypoints);
+	keypoint_cost = calibrated ? (1.0 - smoothing) * keypoint_cost + smoothing * cost : cost;
+	calibrated = true;
+}
+
+void feature_budget::print_stats(const string &name, ostream &out) const
+{
+	if (frames == 0)
+		return;
+	out << "[INFO]: " << name << " keypoints per frame: " << detected_total / frames << " detected, "
+		<< kept_total / frames << " kept (current limit " << limit() << ")" << endl;
+}
@@ -0,0 +1,238 @@
+// created by Davide Baggio 2122547
+
+#include "feature_extraction.hpp"
+#include "category_tasks.hpp"
+
+void merge_regions(vector<Rect> &regions, Size frame, float expand)
+{
+	Rect frame_rect(0, 0, frame.width, frame.height);
+
+	for (Rect &r : regions)
+	{
+		int dx = static_cast<int>(r.width * expand);
+		int dy = static_cast<int>(r.height * expand);
+		r = Rect(r.x - dx, r.y - dy, r.width + 2 * dx, r.height + 2 * dy) & frame_rect;
+	}
+	regions.erase(remove_if(regions.begin(), regions.end(), [](const Rect &r)
+							{ return r.empty(); }),
+				  regions.end());
+
+	bool merged = true;
+	while (merged)
+	{
+		merged = false;
+		for (size_t i = 0; i < regions.size() && !merged; i++)
+		{
+			for (size_t j = i + 1; j < regions.size(); j++)
+			{
+				if ((regions[i] & regions[j]).empty())
+					continue;
+				regions[i] |= regions[j];
+				regions.erase(regions.begin() + j);
+				merged = true;
+				break;
+			}
+		}
+	}
+}
+
+float region_coverage(const vector<Rect> &regions, Size frame)
+{
+	if (frame.area() == 0)
+		return 0.0f;
+
+	double area = 0;
+	for (const Rect &r : regions)
+		area += r.area();
+	return static_cast<float>(area / frame.area());
+}
+
+void detect_in_regions(Feature2D &detector, const Mat &img, const vector<Rect> &regions, vector<KeyPoint> &keypoints, Mat &descriptors, feature_budget *budget)
+{
+	int64 start = getTickCount();
+
+	if (regions.empty() || region_coverage(regions, img.size()) > max_region_coverage)
+	{
+		detector.detect(img, keypoints);
+		if (budget)
+		{
+			budget->record_detection((getTickCount() - start) / getTickFrequency());
+			budget->select(keypoints);
+		}
+		detector.compute(img, keypoints, descriptors);
+		return;
+	}
+
+	// detect in every region first, so the budget is applied to the keypoints of the whole frame
+	keypoints.clear();
+	// scratch buffers of the calling thread, reused across frames
+	static thread_local vector<KeyPoint> region_keypoints;
+	static thread_local vector<KeyPoint> detected;
+	for (size_t k = 0; k < regions.size(); k++)
+	{
+		const Rect &r = regions[k];
+		detector.detect(img(r), region_keypoints);
+		for (KeyPoint &kp : region_keypoints)
+		{
+			kp.pt.x += r.x;
+			kp.pt.y += r.y;
+			kp.class_id = static_cast<int>(k);
+		}
+		keypoints.insert(keypoints.end(), region_keypoints.begin(), region_keypoints.end());
+	}
+	if (budget)
+	{
+		budget->record_detection((getTickCount() - start) / getTickFrequency());
+		budget->select(keypoints);
+	}
+
+	// describe the kept keypoints region by region, in region coordinates
+	detected.clear();
+	detected.swap(keypoints);
+	descriptors.release();
+	Mat region_descriptors;
+	for (size_t k = 0; k < regions.size(); k++)
+	{
+		const Rect &r = regions[k];
+		region_keypoints.clear();
+		for (const KeyPoint &kp : detected)
+		{
+			if (kp.class_id != static_cast<int>(k))
+				continue;
+			region_keypoints.push_back(kp);
+			region_keypoints.back().pt.x -= r.x;
+			region_keypoints.back().pt.y -= r.y;
+		}
+		if (region_keypoints.empty())
+			continue;
+
+		detector.compute(img(r), region_keypoints, region_descriptors);
+		if (region_descriptors.empty())
+			continue;
+
+		for (KeyPoint &kp : region_keypoints)
+		{
+			kp.pt.x += r.x;
+			kp.pt.y += r.y;
+			kp.class_id = -1;
+		}
+		keypoints.insert(keypoints.end(), region_keypoints.begin(), region_keypoints.end());
+		descriptors.push_back(region_descriptors);
+	}
+}
+
+void make_tiles(Size frame, int tile_size, int halo, vector<frame_tile> &tiles)
+{
+	tiles.clear();
+	Rect frame_rect(0, 0, frame.width, frame.height);
+	int columns = max(1, (frame.width + tile_size - 1) / max(tile_size, 1));
+	int rows = max(1, (frame.height + tile_size - 1) / max(tile_size, 1));
+
+	for (int r = 0; r < rows; r++)
+	{
+		int y0 = r * frame.height / rows;
+		int y1 = (r + 1) * frame.height / rows;
+		for (int c = 0; c < columns; c++)
+		{
+			int x0 = c * frame.width / columns;
+			int x1 = (c + 1) * frame.width / columns;
+
+			frame_tile tile;
+			tile.core = Rect(x0, y0, x1 - x0, y1 - y0);
+			tile.area = Rect(x0 - halo, y0 - halo, x1 - x0 + 2 * halo, y1 - y0 + 2 * halo) & frame_rect;
+			tiles.push_back(tile);
+		}
+	}
+}
+
+bool tile_owns(const frame_tile &tile, const Point2f &pt)
+{
+	const Rect &core = tile.core;
+	return pt.x >= core.x && pt.x < core.x + core.width && pt.y >= core.y && pt.y < core.y + core.height;
+}
+
+void detect_in_tiles(Feature2D &detector, const Mat &img, const vector<frame_tile> &tiles, vector<KeyPoint> &keypoints, Mat &descriptors, feature_budget *budget)
+{
+	static const vector<Rect> no_regions;
+	if (tiles.size() <= 1)
+	{
+		detect_in_regions(detector, img, no_regions, keypoints, descriptors, budget);
+		return;
+	}
+
+	int64 start = getTickCount();
+	int count = static_cast<int>(tiles.size());
+
+	// buffers of each tile, owned by the calling thread and written by the tasks through these references
+	static thread_local vector<vector<KeyPoint>> tile_keypoints_buffer;
+	static thread_local vector<Mat> tile_descriptors_buffer;
+	vector<vector<KeyPoint>> &tile_keypoints = tile_keypoints_buffer;
+	vector<Mat> &tile_descriptors = tile_descriptors_buffer;
+	tile_keypoints.resize(count);
+	tile_descriptors.resize(count);
+
+	// detect in every tile first, so the budget is applied to the keypoints of the whole frame
+	auto detect_tile = [&](int k)
+	{
+		const frame_tile &tile = tiles[k];
+		vector<KeyPoint> &found = tile_keypoints[k];
+		detector.detect(img(tile.area), found);
+
+		size_t kept = 0;
+		for (KeyPoint kp : found)
+		{
+			kp.pt.x += tile.area.x;
+			kp.pt.y += tile.area.y;
+			kp.class_id = k;
+			if (tile_owns(tile, kp.pt))
+				found[kept++] = kp;
+		}
+		found.resize(kept);
+	};
+	run_tasks(count, true, detect_tile);
+
+	keypoints.clear();
+	for (int k = 0; k < count; k++)
+		keypoints.insert(keypoints.end(), tile_keypoints[k].begin(), tile_keypoints[k].end());
+	if (budget)
+	{
+		budget->record_detection((getTickCount() - start) / getTickFrequency());
+		budget->select(keypoints);
+	}
+
+	// the kept keypoints go back to their tile, in tile coordinates
+	for (int k = 0; k < count; k++)
+		tile_keypoints[k].clear();
+	for (const KeyPoint &kp : keypoints)
+	{
+		const Rect &area = tiles[kp.class_id].area;
+		tile_keypoints[kp.class_id].push_back(kp);
+		tile_keypoints[kp.class_id].back().pt.x -= area.x;
+		tile_keypoints[kp.class_id].back().pt.y -= area.y;
+	}
+
+	auto describe_tile = [&](int k)
+	{
+		tile_descriptors[k].release();
+		if (tile_keypoints[k].empty())
+			return;
+		detector.compute(img(tiles[k].area), tile_keypoints[k], tile_descriptors[k]);
+	};
+	run_tasks(count, true, describe_tile);
+
+	keypoints.clear();
+	descriptors.release();
+	for (int k = 0; k < count; k++)
+	{
+		if (tile_descriptors[k].empty())
+			continue;
+		for (KeyPoint kp : tile_keypoints[k])
+		{
+			kp.pt.x += tiles[k].area.x;
+			kp.pt.y += tiles[k].area.y;
+			kp.class_id = -1;
+			keypoints.push_back(kp);
+		}
+		descriptors.push_back(tile_descriptors[k]);
+	}
+}
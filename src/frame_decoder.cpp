@@ -0,0 +1,87 @@
+// created by Davide Baggio 2122547
+
+#include "frame_decoder.hpp"
+#include "dataset_pack.hpp"
+#include <fstream>
+
+frame_decoder::frame_decoder(float scale)
+{
+	const int reductions[] = {8, 4, 2};
+	const int reduced_flags[] = {IMREAD_REDUCED_COLOR_8, IMREAD_REDUCED_COLOR_4, IMREAD_REDUCED_COLOR_2};
+
+	for (int k = 0; k < 3; k++)
+	{
+		if (scale * reductions[k] <= 1.0f)
+		{
+			reduction = reductions[k];
+			flags = reduced_flags[k];
+			break;
+		}
+	}
+}
+
+Mat &frame_decoder::decode(const string &path)
+{
+	// encoded frames of a pack are decoded in place from the mapping
+	const uchar *data;
+	size_t size;
+	if (read_dataset_bytes(path, data, size))
+		return decode_buffer(data, size);
+
+	// raw frames of a pack need no decoding, only the reduction
+	if (dataset_pack_open())
+	{
+		Mat raw = read_dataset_image(path, IMREAD_COLOR);
+		if (raw.empty())
+			frame.release();
+		else if (reduction == 1)
+			raw.copyTo(frame);
+		else
+			resize(raw, frame, Size(raw.cols / reduction, raw.rows / reduction), 0, 0, INTER_AREA);
+		return frame;
+	}
+
+	ifstream file(path, ios::binary | ios::ate);
+	if (!file.is_open())
+	{
+		frame.release();
+		return frame;
+	}
+
+	// the buffer keeps its capacity, it grows only for larger files
+	size = static_cast<size_t>(file.tellg());
+	buffer.resize(size);
+	file.seekg(0);
+	file.read(reinterpret_cast<char *>(buffer.data()), size);
+	if (!file || size == 0)
+	{
+		frame.release();
+		return frame;
+	}
+
+	return decode_buffer(buffer.data(), size);
+}
+
+Mat &frame_decoder::decode_buffer(const uchar *data, size_t size)
+{
+	if (size == 0)
+	{
+		frame.release();
+		return frame;
+	}
+
+	// decoding into the previous frame reuses its memory when the size does not change
+	if (imdecode(Mat(1, static_cast<int>(size), CV_8U, const_cast<uchar *>(data)), flags, &frame).empty())
+		frame.release();
+	return frame;
+}
+
+float frame_decoder::get_scale() const
+{
+	return 1.0f / reduction;
+}
+
+Rect frame_decoder::to_native(const Rect &r) const
+{
+	return Rect(r.x * reduction, r.y * reduction, r.width * reduction, r.height * reduction);
+}
@@ -0,0 +1,94 @@
+// created by Davide Baggio 2122547
+
+#include "frame_processing.hpp"
+#include "category_table.hpp"
+#include "descriptor_codec.hpp"
+
+frame_decoder make_decoder(const pipeline_config &config, float &residual_scale)
+{
+	frame_decoder decoder(config.full_decode || config.refine ? 1.0f : config.scale);
+	residual_scale = min(1.0f, config.scale / decoder.get_scale());
+	return decoder;
+}
+
+bool configure_detectors(const pipeline_config &config, detector_set &detectors)
+{
+	if (!detectors.cascade.is_loaded())
+		return false;
+
+	// cascade features of each category
+	for (size_t c = 0; c < config.cascade_types.size() && c < get_categories().size(); c++)
+	{
+		cascade_type type;
+		parse_cascade_type(config.cascade_types[c], type);
+		if (type != detectors.cascade.get_cascade_type(c) && !detectors.cascade.set_cascade_type(c, type))
+			return false;
+	}
+
+	// ORB and SIFT match the model views and the categories of a frame in parallel
+	detectors.orb.set_parallel_categories(config.parallel_categories);
+	detectors.sift.set_parallel_categories(config.parallel_categories);
+	detectors.orb.set_parallel_views(config.parallel_views);
+	detectors.sift.set_parallel_views(config.parallel_views);
+
+	// per-frame lines of the detectors
+	detectors.cascade.set_frame_log(config.frame_log);
+	detectors.orb.set_frame_log(config.frame_log);
+	detectors.sift.set_frame_log(config.frame_log);
+
+	// fusion parameters: fraction of the best points used and weight of each of them
+	detectors.cascade.set_fusion(1.0f, 0.5);
+	detectors.orb.set_fusion(0.4f, 1.0);
+	detectors.sift.set_fusion(0.3f, 0.5);
+
+	// large frames processed as overlapping tiles, the tiles of ORB and SIFT in parallel
+	if (config.tile_size > 0)
+	{
+		detectors.cascade.set_tiling(config.tile_size, config.tile_halo);
+		detectors.orb.set_tiling(config.tile_size, config.tile_halo);
+		detectors.sift.set_tiling(config.tile_size, config.tile_halo);
+	}
+
+	// HAAR detections as the regions where ORB and SIFT extract features
+	if (config.roi_expand > 0.0f)
+	{
+		detectors.cascade.set_proposals(config.roi_expand);
+		detectors.orb.set_use_regions(true);
+		detectors.sift.set_use_regions(true);
+	}
+
+	// ORB and SIFT keep only the strongest keypoints that fit in the time budget of the frame
+	if (config.feature_budget_ms > 0.0)
+	{
+		detectors.orb.set_budget(config.feature_budget_ms, config.max_keypoints);
+		detectors.sift.set_budget(config.feature_budget_ms, config.max_keypoints);
+	}
+
+	// compact SIFT descriptors, encoded before the vocabulary is built on them
+	descriptor_mode sift_mode;
+	int sift_dims;
+	parse_descriptor_mode(config.sift_descriptors, sift_mode, sift_dims);
+	detectors.sift.set_descriptor_mode(sift_mode, sift_dims);
+
+	// model stores on huge pages, after the descriptors have their final form
+	if (config.huge_pages)
+	{
+		detectors.orb.set_huge_pages(true);
+		detectors.sift.set_huge_pages(true);
+	}
+
+	// vocabulary tree preselection of the model views matched by ORB and SIFT
+	if (config.candidate_views > 0)
+	{
+		detectors.orb.set_view_preselection(config.candidate_views, config.shared_views);
+		detectors.sift.set_view_preselection(config.candidate_views, config.shared_views);
+	}
+
+	// bounded search of the model views, on the final form of the descriptors
+	if (config.bounded_views)
+	{
+		detectors.orb.set_bounded_views(true);
+		detectors.sift.set_bounded_views(true);
+	}
+	return true;
+}
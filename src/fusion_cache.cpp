@@ -0,0 +1,219 @@
+// created by Davide Baggio 2122547
+
+#include "fusion_cache.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+// identification of the file format
+const static char cache_magic[8] = {'F', 'U', 'S', 'C', 'A', 'C', 'H', '2'};
+
+template <typename T>
+static void write_value(ofstream &out, const T &value)
+{
+	out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+static void write_vector(ofstream &out, const vector<T> &values)
+{
+	write_value(out, static_cast<uint32_t>(values.size()));
+	out.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+}
+
+static void write_string(ofstream &out, const string &value)
+{
+	write_value(out, static_cast<uint32_t>(value.size()));
+	out.write(value.data(), value.size());
+}
+
+template <typename T>
+static bool read_value(ifstream &in, T &value)
+{
+	return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+template <typename T>
+static bool read_vector(ifstream &in, vector<T> &values)
+{
+	uint32_t size;
+	if (!read_value(in, size))
+		return false;
+	values.resize(size);
+	return static_cast<bool>(in.read(reinterpret_cast<char *>(values.data()), size * sizeof(T)));
+}
+
+static bool read_string(ifstream &in, string &value)
+{
+	uint32_t size;
+	if (!read_value(in, size))
+		return false;
+	value.resize(size);
+	return static_cast<bool>(in.read(&value[0], size));
+}
+
+fusion_cache::fusion_cache(const vector<string> &category_names, float scale)
+	: category_names(category_names), num_categories(static_cast<int>(category_names.size())), scale(scale)
+{
+}
+
+void fusion_cache::add_failed(const string &name)
+{
+	frames.emplace_back();
+	cached_frame &frame = frames.back();
+	frame.name = name;
+	frame.decoded = false;
+
+	size_t num_blocks = static_cast<size_t>(DETECTOR_COUNT) * num_categories;
+	frame.offsets.assign(num_blocks, 0);
+	frame.counts.assign(num_blocks, 0);
+}
+
+bool fusion_cache::save(const string &path) const
+{
+	ofstream out(path, ios::binary);
+	if (!out.is_open())
+		return false;
+
+	out.write(cache_magic, sizeof(cache_magic));
+	write_value(out, scale);
+	write_value(out, static_cast<uint32_t>(num_categories));
+	for (const string &name : category_names)
+		write_string(out, name);
+	write_value(out, static_cast<uint32_t>(frames.size()));
+	for (const cached_frame &frame : frames)
+	{
+		write_string(out, frame.name);
+		write_value(out, static_cast<uint8_t>(frame.decoded));
+		write_value(out, static_cast<uint32_t>(frame.labels.size()));
+		for (const auto &label : frame.labels)
+		{
+			write_string(out, label.first);
+			const Rect &r = label.second;
+			int32_t box[4] = {r.x, r.y, r.width, r.height};
+			out.write(reinterpret_cast<const char *>(box), sizeof(box));
+		}
+		write_vector(out, frame.points);
+		write_vector(out, frame.distances);
+		write_vector(out, frame.accepted);
+		write_vector(out, frame.offsets);
+		write_vector(out, frame.counts);
+	}
+	return static_cast<bool>(out);
+}
+
+bool fusion_cache::load(const string &path)
+{
+	frames.clear();
+	ifstream in(path, ios::binary);
+	if (!in.is_open())
+		return false;
+
+	// a cache of another scale or of other categories is a miss
+	char magic[8];
+	float cached_scale;
+	uint32_t categories;
+	if (!in.read(magic, sizeof(magic)) || memcmp(magic, cache_magic, sizeof(magic)) != 0 || !read_value(in, cached_scale) ||
+		cached_scale != scale || !read_value(in, categories) || static_cast<int>(categories) != num_categories)
+		return false;
+	for (const string &name : category_names)
+	{
+		string cached_name;
+		if (!read_string(in, cached_name) || cached_name != name)
+			return false;
+	}
+
+	uint32_t count;
+	if (!read_value(in, count))
+		return false;
+
+	size_t num_blocks = static_cast<size_t>(DETECTOR_COUNT) * num_categories;
+	frames.resize(count);
+	for (cached_frame &frame : frames)
+	{
+		uint32_t num_labels;
+		uint8_t decoded;
+		if (!read_string(in, frame.name) || !read_value(in, decoded) || !read_value(in, num_labels))
+			break;
+		frame.decoded = decoded != 0;
+		for (uint32_t k = 0; k < num_labels && in; k++)
+		{
+			string name;
+			int32_t box[4];
+			if (read_string(in, name) && in.read(reinterpret_cast<char *>(box), sizeof(box)))
+				frame.labels[name] = Rect(box[0], box[1], box[2], box[3]);
+		}
+
+		bool valid = read_vector(in, frame.points) && read_vector(in, frame.distances) && read_vector(in, frame.accepted) &&
+					 read_vector(in, frame.offsets) && read_vector(in, frame.counts);
+		valid = valid && frame.distances.size() == frame.points.size() && frame.accepted.size() == frame.points.size() &&
+				frame.offsets.size() == num_blocks && frame.counts.size() == num_blocks;
+		for (size_t b = 0; valid && b < num_blocks; b++)
+			valid = static_cast<size_t>(frame.offsets[b]) + frame.counts[b] <= frame.points.size();
+		if (!valid)
+		{
+			frames.clear();
+			return false;
+		}
+	}
+
+	if (!in)
+	{
+		frames.clear();
+		return false;
+	}
+	return true;
+}
+
+bool fusion_cache::matches(const vector<string> &names) const
+{
+	if (names.size() != frames.size())
+		return false;
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		if (names[i] != frames[i].name)
+			return false;
+	}
+	return true;
+}
+
+void fusion_cache::fuse(size_t index, int category, const fusion_setting &setting, weighted_points &fused) const
+{
+	const cached_frame &frame = frames[index];
+	fused.clear();
+	for (int d = 0; d < DETECTOR_COUNT; d++)
+	{
+		size_t b = static_cast<size_t>(d) * num_categories + category;
+		uint32_t offset = frame.offsets[b];
+		point_view block(frame.points.data() + offset, frame.distances.data() + offset, frame.counts[b]);
+
+		const uint8_t *accepted = frame.accepted.data() + offset;
+		auto color_check = [&](size_t i)
+		{ return accepted[i] != 0; };
+		fuse_block(block.top(setting.fractions[d]), setting.weights[d], color_check, fused);
+	}
+}
+
+detection_score fusion_cache::evaluate(const fusion_setting &setting, const vector<string> &names, weighted_points &scratch) const
+{
+	detection_score score;
+	vector<Rect> boxes(num_categories);
+	for (size_t i = 0; i < frames.size(); i++)
+	{
+		if (!frames[i].decoded)
+			continue;
+		for (int c = 0; c < num_categories; c++)
+		{
+			fuse(i, c, setting, scratch);
+			boxes[c] = get_dense_cluster(scratch, setting.eps, setting.min_weight);
+		}
+		score_frame(frames[i].labels, names, boxes, score);
+	}
+	return score;
+}
+
+size_t fusion_cache::size() const
+{
+	return count_if(frames.begin(), frames.end(), [](const cached_frame &frame)
+					{ return frame.decoded; });
+}
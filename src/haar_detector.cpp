@@ -1,113 +1,225 @@
 // created by Davide Baggio 2122547
 
 #include "haar_detector.hpp"
+#include "memory_tracker.hpp"
+#include "feature_extraction.hpp"
+#include "dataset_pack.hpp"
+#include "negative_mining.hpp"
+#include "category_table.hpp"
+#include <limits>
+
+/*
+ * Loads a cascade from the dataset pack if one is open, otherwise from its file.
+ */
+static bool load_cascade(CascadeClassifier &classifier, const string &path)
+{
+	if (!dataset_pack_open())
+		return classifier.load(path);
+
+	string xml;
+	return read_dataset_text(path, xml) && load_cascade_from_memory(classifier, xml);
+}
 
 haar_detector::haar_detector()
 {
-	// cascade file path
-	string sugar_cascade_path = base + sugar + cascade;
-	string mustard_cascade_path = base + mustard + cascade;
-	string drill_cascade_path = base + drill + cascade;
+	mem_scope scope(STAGE_MODEL_LOADING);
 
-	if (!cascade_sugar.load(sugar_cascade_path) || !cascade_mustard.load(mustard_cascade_path) || !cascade_drill.load(drill_cascade_path))
+	const vector<category_info> &categories = get_categories();
+	int num_categories = static_cast<int>(categories.size());
+	cascades.resize(num_categories);
+	types.assign(num_categories, CASCADE_HAAR);
+	objects.resize(num_categories);
+	tile_objects.resize(num_categories);
+	display_frames.resize(num_categories);
+
+	for (int c = 0; c < num_categories; c++)
 	{
-		cout << "[ERROR]: loading cascade" << endl;
-		exit(1);
+		string path = get_cascade_path(categories[c].folder, CASCADE_HAAR);
+		if (!load_cascade(cascades[c], path))
+		{
+			cout << "[ERROR]: loading cascade " << path << endl;
+			loaded = false;
+		}
 	}
 }
 
-void haar_detector::compute_detection(Mat img)
+bool haar_detector::is_loaded() const
 {
-	this->test = img.clone();
-	Mat gray;
+	return loaded;
+}
+
+void haar_detector::compute_detection(const Mat &img, frame_result &result)
+{
+	mem_scope scope(STAGE_HAAR);
+
+	// copies into the buffer of the previous frame, the caller draws on img afterwards
+	img.copyTo(test);
 	cvtColor(img, gray, COLOR_BGR2GRAY);
 	equalizeHist(gray, gray);
 
-	vector<Rect> obj_s, obj_m, obj_d;
-	cascade_sugar.detectMultiScale(gray, obj_s, 1.1, 2, 0 | cv::CASCADE_SCALE_IMAGE);
-	cascade_mustard.detectMultiScale(gray, obj_m, 1.1, 2, 0 | cv::CASCADE_SCALE_IMAGE);
-	cascade_drill.detectMultiScale(gray, obj_d, 1.1, 2, 0 | cv::CASCADE_SCALE_IMAGE);
-	vector<Point> pp_s, pp_m, pp_d;
-	for (int i = 0; i < obj_s.size(); i++)
-	{
-		pp_s.push_back(Point(obj_s[i].x + obj_s[i].width / 2, obj_s[i].y + obj_s[i].height / 2));
-	}
+	int num_categories = static_cast<int>(cascades.size());
+	if (tile_size > 0)
+		make_tiles(gray.size(), tile_size, tile_halo, tiles);
+	else
+		tiles.clear();
 
-	for (int i = 0; i < obj_m.size(); i++)
+	auto detect_category = [&](int c)
 	{
-		pp_m.push_back(Point(obj_m[i].x + obj_m[i].width / 2, obj_m[i].y + obj_m[i].height / 2));
-	}
+		mem_scope category_scope(STAGE_HAAR, c);
+		if (tiles.size() <= 1)
+		{
+			cascades[c].detectMultiScale(gray, objects[c], cascade_scale_factor, cascade_min_neighbors, 0 | cv::CASCADE_SCALE_IMAGE);
+			return;
+		}
 
-	for (int i = 0; i < obj_d.size(); i++)
+		// a detection found in the halo of two tiles is kept by the tile its center belongs to
+		objects[c].clear();
+		for (const frame_tile &tile : tiles)
+		{
+			cascades[c].detectMultiScale(gray(tile.area), tile_objects[c], cascade_scale_factor, cascade_min_neighbors, 0 | cv::CASCADE_SCALE_IMAGE);
+			for (Rect r : tile_objects[c])
+			{
+				r.x += tile.area.x;
+				r.y += tile.area.y;
+				if (tile_owns(tile, Point2f(r.x + r.width / 2, r.y + r.height / 2)))
+					objects[c].push_back(r);
+			}
+		}
+	};
+	run_category_tasks(num_categories, tiles.size() > 1 && parallel_categories, detect_category);
+
+	// blocks are written in category order
+	for (int c = 0; c < num_categories; c++)
 	{
-		pp_d.push_back(Point(obj_d[i].x + obj_d[i].width / 2, obj_d[i].y + obj_d[i].height / 2));
+		result.begin_block(DETECTOR_HAAR, c);
+		for (const Rect &r : objects[c])
+		{
+			result.push(Point(r.x + r.width / 2, r.y + r.height / 2), 0.0f);
+		}
+		result.end_block();
+
+		if (proposal_expand > 0.0f)
+			result.get_regions().insert(result.get_regions().end(), objects[c].begin(), objects[c].end());
 	}
-	points[0] = pp_s;
-	points[1] = pp_m;
-	points[2] = pp_d;
 
-	cout << "Best matches found from HAAR detector\n";
-}
+	if (proposal_expand > 0.0f)
+		merge_regions(result.get_regions(), img.size(), proposal_expand);
 
-vector<vector<Point>> haar_detector::get_points()
-{
-	return points;
+	if (log_frames)
+		cout << "Best matches found from HAAR detector\n";
 }
 
-void haar_detector::display_points()
+void haar_detector::display_points(const frame_result &result)
 {
 
-	vector<Mat> mat_matches = vector<Mat>(3);
-	mat_matches[0] = test.clone(); // sugar
-	mat_matches[1] = test.clone(); // mustard
-	mat_matches[2] = test.clone(); // drill
+	vector<Mat> &mat_matches = display_frames;
+	for (Mat &frame : mat_matches)
+		test.copyTo(frame);
 
-	for (size_t i = 0; i < points.size(); i++)
+	for (size_t i = 0; i < mat_matches.size(); i++)
 	{
-		if (points[i].size() == 0)
+		point_view points = result.view(DETECTOR_HAAR, i);
+		if (points.size() == 0)
 		{
 			cout << "HAAR: No points found for type " << i << endl;
 			continue;
 		}
-		for (int j = 0; j < points[i].size(); j++)
+		for (const Point &pt : points)
 		{
-			Point pt = points[i][j];
 			circle(mat_matches[i], pt, 5, Scalar(0, 255, 0), 2);
 		}
 	}
 
 	for (int i = 0; i < mat_matches.size(); i++)
 	{
-
-		string category;
-		if (i == 0)
-		{
-			category = "sugar_box";
-		}
-		else if (i == 1)
-		{
-			category = "mustard_bottle";
-		}
-		else if (i == 2)
-		{
-			category = "power_drill";
-		}
 		if (mat_matches[i].empty())
 		{
 			cout << "HAAR: No matches found for type " << i << endl;
 			continue;
 		}
-		imshow(category + " matches", mat_matches[i]);
+		imshow(get_categories()[i].name + " matches", mat_matches[i]);
 	}
 	waitKey(0);
 }
 
-void haar_detector::set_points(vector<Point> points, size_t index)
+bool haar_detector::accept_point(const Mat &img, int category, const Point &pt) const
+{
+	const category_info &info = get_categories()[category];
+	if (info.colors.empty())
+		return true;
+	return info.accept_color(img.at<Vec3b>(pt));
+}
+
+void haar_detector::set_proposals(float expand)
 {
-	if (index < 0 || index > 3)
+	proposal_expand = expand;
+}
+
+bool haar_detector::set_cascade_type(int category, cascade_type type)
+{
+	mem_scope scope(STAGE_MODEL_LOADING, category);
+
+	CascadeClassifier classifier;
+	string path = get_cascade_path(get_categories()[category].folder, type);
+	if (!load_cascade(classifier, path))
 	{
-		cout << "[ERROR]: invalid index for insertion\n";
-		return;
+		cout << "[ERROR]: loading cascade " << path << endl;
+		return false;
 	}
-	this->points[index] = points;
-}
\ No newline at end of file
+
+	cascades[category] = classifier;
+	types[category] = type;
+	return true;
+}
+
+cascade_type haar_detector::get_cascade_type(int category) const
+{
+	return types[category];
+}
+
+bool benchmark_cascade(const string &category, cascade_type type, const vector<String> &filenames, cascade_benchmark &result)
+{
+	CascadeClassifier classifier;
+	if (!load_cascade(classifier, get_cascade_path(category, type)))
+		return false;
+
+	string name = category.substr(0, category.size() - 1);
+	vector<Rect> objects;
+	vector<int> reject_levels;
+	vector<double> level_weights;
+	Mat gray;
+
+	for (size_t i = 0; i < filenames.size(); i++)
+	{
+		Mat img = read_dataset_image(filenames[i], IMREAD_COLOR);
+		if (img.empty())
+			continue;
+		cvtColor(img, gray, COLOR_BGR2GRAY);
+		equalizeHist(gray, gray);
+
+		int64 start = getTickCount();
+		classifier.detectMultiScale(gray, objects, reject_levels, level_weights, cascade_scale_factor, cascade_min_neighbors,
+									CASCADE_SCALE_IMAGE, Size(), Size(), true);
+		result.seconds += (getTickCount() - start) / getTickFrequency();
+		result.frames++;
+
+		Rect box;
+		double best_weight = -numeric_limits<double>::max();
+		for (size_t k = 0; k < objects.size() && k < level_weights.size(); k++)
+		{
+			if (level_weights[k] > best_weight)
+			{
+				best_weight = level_weights[k];
+				box = objects[k];
+			}
+		}
+
+		map<string, Rect> labels = read_boxes(get_label_path(filenames[i]));
+		auto label = labels.find(name);
+		if (label != labels.end())
+			result.score.add(intersection_over_union(label->second, box));
+		else if (!box.empty())
+			result.false_detections++;
+	}
+	return true;
+}
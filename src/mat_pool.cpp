@@ -0,0 +1,121 @@
+// created by Davide Baggio 2122547
+
+#include "mat_pool.hpp"
+
+static pooled_mat_allocator *installed_pool = nullptr;
+
+pooled_mat_allocator::pooled_mat_allocator(size_t max_bytes, MatAllocator *parent) : max_bytes(max_bytes)
+{
+	this->parent = parent ? parent : Mat::getDefaultAllocator();
+}
+
+UMatData *pooled_mat_allocator::allocate(int dims, const int *sizes, int type, void *data, size_t *step, AccessFlag flags, UMatUsageFlags usage_flags) const
+{
+	// buffers given by the caller are only wrapped, the parent releases them
+	if (data != nullptr)
+		return parent->allocate(dims, sizes, type, data, step, flags, usage_flags);
+
+	// continuous layout, the same the parent computes for a new buffer
+	size_t total = CV_ELEM_SIZE(type);
+	for (int i = dims - 1; i >= 0; i--)
+	{
+		if (step)
+			step[i] = total;
+		total *= sizes[i];
+	}
+	requests++;
+
+	if (total >= mat_pool_min_bytes)
+	{
+		lock_guard<mutex> guard(lock);
+		auto found = free_buffers.find(total);
+		if (found != free_buffers.end())
+		{
+			// the most recently released buffer, the most likely to be still in cache
+			UMatData *u = *found->second.back();
+			released.erase(found->second.back());
+			found->second.pop_back();
+			if (found->second.empty())
+				free_buffers.erase(found);
+			pooled_bytes -= u->size;
+			reused++;
+			return u;
+		}
+	}
+
+	UMatData *u = parent->allocate(dims, sizes, type, data, step, flags, usage_flags);
+	if (u)
+		u->prevAllocator = u->currAllocator = this;
+	return u;
+}
+
+bool pooled_mat_allocator::allocate(UMatData *data, AccessFlag access_flags, UMatUsageFlags usage_flags) const
+{
+	return parent->allocate(data, access_flags, usage_flags);
+}
+
+UMatData *pooled_mat_allocator::take_oldest(size_t size) const
+{
+	auto found = free_buffers.find(size);
+	UMatData *u = *found->second.front();
+	released.erase(found->second.front());
+	found->second.erase(found->second.begin());
+	if (found->second.empty())
+		free_buffers.erase(found);
+	pooled_bytes -= u->size;
+	return u;
+}
+
+void pooled_mat_allocator::deallocate(UMatData *data) const
+{
+	if (!data)
+		return;
+
+	if ((data->flags & UMatData::USER_ALLOCATED) || data->size < mat_pool_min_bytes || data->size > max_bytes)
+	{
+		parent->deallocate(data);
+		return;
+	}
+
+	// buffers evicted to make room, freed once the lock is released
+	vector<UMatData *> freed;
+	{
+		lock_guard<mutex> guard(lock);
+		auto found = free_buffers.find(data->size);
+		if (found != free_buffers.end() && found->second.size() >= mat_pool_max_per_size)
+			freed.push_back(take_oldest(data->size));
+		while (pooled_bytes + data->size > max_bytes)
+			freed.push_back(take_oldest(released.front()->size));
+
+		released.push_back(data);
+		free_buffers[data->size].push_back(prev(released.end()));
+		pooled_bytes += data->size;
+	}
+
+	evicted += freed.size();
+	for (UMatData *u : freed)
+		parent->deallocate(u);
+}
+
+void pooled_mat_allocator::print_stats(ostream &out) const
+{
+	size_t total = requests.load();
+	size_t hits = reused.load();
+	lock_guard<mutex> guard(lock);
+	out << "[INFO]: Mat pool: " << total << " allocations, " << hits << " reused (" << 100.0 * hits / max<size_t>(total, 1) << "%), "
+		<< evicted.load() << " evicted, " << pooled_bytes / 1024 << " KB pooled" << endl;
+}
+
+void enable_mat_pool(size_t max_bytes)
+{
+	if (installed_pool != nullptr)
+		return;
+	installed_pool = new pooled_mat_allocator(max_bytes);
+	Mat::setDefaultAllocator(installed_pool);
+}
+
+void print_mat_pool_stats(ostream &out)
+{
+	if (installed_pool != nullptr)
+		installed_pool->print_stats(out);
+}
@@ -0,0 +1,317 @@
+// created by Davide Baggio 2122547
+
+#include "memory_tracker.hpp"
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <iomanip>
+
+static const char *stage_names[STAGE_COUNT] = {
+	"other", "model_loading", "decode", "haar", "orb", "sift", "fusion", "clustering", "output"};
+
+static const char *source_names[SOURCE_COUNT] = {"heap", "mat"};
+
+// one slot per (stage, category), the extra category slot is CATEGORY_NONE
+static const int CATEGORY_SLOTS = MAX_TRACKED_CATEGORIES + 1;
+static const int SLOT_COUNT = STAGE_COUNT * CATEGORY_SLOTS;
+
+static mem_counters counters[SOURCE_COUNT][SLOT_COUNT];
+static atomic<int64_t> global_live{0};
+static atomic<int64_t> global_peak{0};
+
+// attribution of the current thread, plain ints so they are usable from operator new
+static thread_local int current_stage = STAGE_OTHER;
+static thread_local int current_category = CATEGORY_NONE;
+
+static void update_peak(atomic<int64_t> &peak, int64_t value)
+{
+	int64_t prev = peak.load(memory_order_relaxed);
+	while (value > prev && !peak.compare_exchange_weak(prev, value, memory_order_relaxed))
+	{
+	}
+}
+
+static int category_slot(int category)
+{
+	if (category < 0)
+		return MAX_TRACKED_CATEGORIES;
+	return category < MAX_TRACKED_CATEGORIES ? category : MAX_TRACKED_CATEGORIES - 1;
+}
+
+int mem_record_alloc(mem_source source, size_t bytes)
+{
+	int slot = current_stage * CATEGORY_SLOTS + category_slot(current_category);
+	mem_counters &c = counters[source][slot];
+	int64_t live = c.live_bytes.fetch_add(bytes, memory_order_relaxed) + bytes;
+	update_peak(c.peak_bytes, live);
+	c.total_bytes.fetch_add(bytes, memory_order_relaxed);
+	c.allocations.fetch_add(1, memory_order_relaxed);
+	update_peak(global_peak, global_live.fetch_add(bytes, memory_order_relaxed) + bytes);
+	return slot;
+}
+
+void mem_record_free(mem_source source, int slot, size_t bytes)
+{
+	if (slot < 0 || slot >= SLOT_COUNT)
+		return;
+	mem_counters &c = counters[source][slot];
+	c.live_bytes.fetch_sub(bytes, memory_order_relaxed);
+	c.deallocations.fetch_add(1, memory_order_relaxed);
+	global_live.fetch_sub(bytes, memory_order_relaxed);
+}
+
+mem_scope::mem_scope(mem_stage stage, int category)
+{
+	prev_stage = current_stage;
+	prev_category = current_category;
+	current_stage = stage;
+	if (category != CATEGORY_NONE)
+		current_category = category;
+}
+
+mem_scope::~mem_scope()
+{
+	current_stage = prev_stage;
+	current_category = prev_category;
+}
+
+tracking_mat_allocator::tracking_mat_allocator(MatAllocator *parent)
+{
+	this->parent = parent ? parent : Mat::getStdAllocator();
+}
+
+UMatData *tracking_mat_allocator::allocate(int dims, const int *sizes, int type, void *data, size_t *step, AccessFlag flags, UMatUsageFlags usage_flags) const
+{
+	UMatData *u = parent->allocate(dims, sizes, type, data, step, flags, usage_flags);
+	if (!u)
+		return u;
+
+	// route the release back through this allocator
+	u->prevAllocator = u->currAllocator = this;
+	if (!(u->flags & UMatData::USER_ALLOCATED))
+		u->userdata = reinterpret_cast<void *>(static_cast<intptr_t>(mem_record_alloc(SOURCE_MAT, u->size)));
+	else
+		u->userdata = reinterpret_cast<void *>(static_cast<intptr_t>(-1));
+	return u;
+}
+
+bool tracking_mat_allocator::allocate(UMatData *data, AccessFlag access_flags, UMatUsageFlags usage_flags) const
+{
+	return parent->allocate(data, access_flags, usage_flags);
+}
+
+void tracking_mat_allocator::deallocate(UMatData *data) const
+{
+	if (!data)
+		return;
+	int slot = static_cast<int>(reinterpret_cast<intptr_t>(data->userdata));
+	if (slot >= 0)
+		mem_record_free(SOURCE_MAT, slot, data->size);
+	data->userdata = nullptr;
+	parent->deallocate(data);
+}
+
+void enable_mat_tracking()
+{
+	static tracking_mat_allocator allocator;
+	Mat::setDefaultAllocator(&allocator);
+}
+
+#ifdef MEMORY_TRACKING
+
+// every heap block is preceded by a header with its size, accounting slot and distance from the malloc'ed base
+struct alloc_header
+{
+	size_t size;
+	int32_t slot;
+	uint32_t offset;
+};
+
+static_assert(sizeof(alloc_header) == 16, "allocation header must keep 16-byte alignment");
+
+static void *tracked_alloc(size_t size, size_t align)
+{
+	size_t offset = align > sizeof(alloc_header) ? align : sizeof(alloc_header);
+	void *base = nullptr;
+	if (align > sizeof(alloc_header))
+	{
+		if (posix_memalign(&base, align, size + offset) != 0)
+			base = nullptr;
+	}
+	else
+	{
+		base = malloc(size + offset);
+	}
+	if (!base)
+		return nullptr;
+
+	char *ptr = static_cast<char *>(base) + offset;
+	alloc_header *header = reinterpret_cast<alloc_header *>(ptr) - 1;
+	header->size = size;
+	header->slot = mem_record_alloc(SOURCE_HEAP, size);
+	header->offset = static_cast<uint32_t>(offset);
+	return ptr;
+}
+
+static void tracked_free(void *ptr)
+{
+	if (!ptr)
+		return;
+	alloc_header *header = reinterpret_cast<alloc_header *>(ptr) - 1;
+	mem_record_free(SOURCE_HEAP, header->slot, header->size);
+	free(static_cast<char *>(ptr) - header->offset);
+}
+
+static void *tracked_new(size_t size, size_t align)
+{
+	if (size == 0)
+		size = 1;
+	while (true)
+	{
+		void *ptr = tracked_alloc(size, align);
+		if (ptr)
+			return ptr;
+		new_handler handler = get_new_handler();
+		if (!handler)
+			throw bad_alloc();
+		handler();
+	}
+}
+
+void *operator new(size_t size) { return tracked_new(size, 0); }
+void *operator new[](size_t size) { return tracked_new(size, 0); }
+void *operator new(size_t size, const nothrow_t &) noexcept { return tracked_alloc(size ? size : 1, 0); }
+void *operator new[](size_t size, const nothrow_t &) noexcept { return tracked_alloc(size ? size : 1, 0); }
+void *operator new(size_t size, align_val_t align) { return tracked_new(size, static_cast<size_t>(align)); }
+void *operator new[](size_t size, align_val_t align) { return tracked_new(size, static_cast<size_t>(align)); }
+
+void operator delete(void *ptr) noexcept { tracked_free(ptr); }
+void operator delete[](void *ptr) noexcept { tracked_free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { tracked_free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { tracked_free(ptr); }
+void operator delete(void *ptr, const nothrow_t &) noexcept { tracked_free(ptr); }
+void operator delete[](void *ptr, const nothrow_t &) noexcept { tracked_free(ptr); }
+void operator delete(void *ptr, align_val_t) noexcept { tracked_free(ptr); }
+void operator delete[](void *ptr, align_val_t) noexcept { tracked_free(ptr); }
+void operator delete(void *ptr, size_t, align_val_t) noexcept { tracked_free(ptr); }
+void operator delete[](void *ptr, size_t, align_val_t) noexcept { tracked_free(ptr); }
+
+bool heap_tracking_enabled()
+{
+	return true;
+}
+
+#else
+
+bool heap_tracking_enabled()
+{
+	return false;
+}
+
+#endif // MEMORY_TRACKING
+
+static string format_bytes(int64_t bytes)
+{
+	stringstream ss;
+	ss << fixed << setprecision(1);
+	if (bytes >= (1 << 20) || bytes <= -(1 << 20))
+		ss << bytes / 1048576.0 << " MiB";
+	else if (bytes >= (1 << 10) || bytes <= -(1 << 10))
+		ss << bytes / 1024.0 << " KiB";
+	else
+		ss << bytes << " B";
+	return ss.str();
+}
+
+static string category_name(int slot)
+{
+	if (slot == MAX_TRACKED_CATEGORIES)
+		return "-";
+	return to_string(slot);
+}
+
+void print_memory_report(ostream &out)
+{
+	out << "[MEMORY]: allocation report (heap tracking " << (heap_tracking_enabled() ? "on" : "off, build with -DMEMORY_TRACKING=ON") << ")\n";
+	out << left << setw(6) << "source" << " " << setw(14) << "stage" << " " << setw(4) << "cat"
+		<< right << setw(12) << "live" << setw(12) << "peak" << setw(12) << "total" << setw(10) << "allocs" << setw(10) << "frees" << "\n";
+
+	for (int s = 0; s < SOURCE_COUNT; s++)
+	{
+		for (int stage = 0; stage < STAGE_COUNT; stage++)
+		{
+			for (int cat = 0; cat < CATEGORY_SLOTS; cat++)
+			{
+				const mem_counters &c = counters[s][stage * CATEGORY_SLOTS + cat];
+				if (c.allocations.load() == 0)
+					continue;
+				out << left << setw(6) << source_names[s] << " " << setw(14) << stage_names[stage] << " " << setw(4) << category_name(cat)
+					<< right << setw(12) << format_bytes(c.live_bytes.load()) << setw(12) << format_bytes(c.peak_bytes.load())
+					<< setw(12) << format_bytes(c.total_bytes.load()) << setw(10) << c.allocations.load() << setw(10) << c.deallocations.load() << "\n";
+			}
+		}
+	}
+
+	out << "[MEMORY]: per-stage live bytes (heap + mat):";
+	for (int stage = 0; stage < STAGE_COUNT; stage++)
+	{
+		int64_t live = 0;
+		for (int s = 0; s < SOURCE_COUNT; s++)
+			for (int cat = 0; cat < CATEGORY_SLOTS; cat++)
+				live += counters[s][stage * CATEGORY_SLOTS + cat].live_bytes.load();
+		out << " " << stage_names[stage] << "=" << format_bytes(live);
+	}
+	out << "\n[MEMORY]: live " << format_bytes(global_live.load()) << ", peak " << format_bytes(global_peak.load()) << endl;
+}
+
+void print_memory_sample(ostream &out)
+{
+	stringstream ss;
+	ss << "[MEMORY]: live " << format_bytes(global_live.load()) << " peak " << format_bytes(global_peak.load()) << " |";
+	for (int stage = 0; stage < STAGE_COUNT; stage++)
+	{
+		int64_t live = 0;
+		for (int s = 0; s < SOURCE_COUNT; s++)
+			for (int cat = 0; cat < CATEGORY_SLOTS; cat++)
+				live += counters[s][stage * CATEGORY_SLOTS + cat].live_bytes.load();
+		if (live != 0)
+			ss << " " << stage_names[stage] << "=" << format_bytes(live);
+	}
+	out << ss.str() << endl;
+}
+
+static thread sampler_thread;
+static mutex sampler_mutex;
+static condition_variable sampler_cv;
+static bool sampler_running = false;
+
+void start_memory_sampler(unsigned interval_ms, ostream &out)
+{
+	stop_memory_sampler();
+	{
+		lock_guard<mutex> lock(sampler_mutex);
+		sampler_running = true;
+	}
+	sampler_thread = thread([interval_ms, &out]()
+							{
+		unique_lock<mutex> lock(sampler_mutex);
+		while (!sampler_cv.wait_for(lock, chrono::milliseconds(interval_ms), []
+									{ return !sampler_running; }))
+		{
+			print_memory_sample(out);
+		} });
+}
+
+void stop_memory_sampler()
+{
+	{
+		lock_guard<mutex> lock(sampler_mutex);
+		sampler_running = false;
+	}
+	sampler_cv.notify_all();
+	if (sampler_thread.joinable())
+		sampler_thread.join();
+}
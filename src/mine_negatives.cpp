@@ -0,0 +1,239 @@
+// created by Davide Baggio 2122547
+
+#include "detection.hpp"
+#include "negative_mining.hpp"
+#include "category_table.hpp"
+#include "option_value.hpp"
+#include <atomic>
+#include <filesystem>
+#include <set>
+#include <sstream>
+#include <thread>
+
+namespace fs = filesystem;
+
+/*
+ * Options of the mining tool.
+ */
+struct mining_config
+{
+	// directories of background images scanned in addition to the negatives of each category
+	vector<string> backgrounds;
+	// output directory, a folder per category with `negative_images/` and `negative.txt`
+	string output = "output/negatives/";
+	// add the mined negatives to the dataset itself
+	bool in_place = false;
+	// maximum number of false positives kept per image
+	int max_per_image = 10;
+	// number of worker threads
+	int threads = max(1u, thread::hardware_concurrency());
+};
+
+static void print_usage(const string &program)
+{
+	cout << "Usage: " << program << " [options]\n"
+		 << "  --background <dir>      also scan the images of <dir> (can be repeated)\n"
+		 << "  --output <dir>          write the mined negatives of each category to <dir>/<category> (default output/negatives)\n"
+		 << "  --in-place              add the mined negatives to the negative images of the dataset\n"
+		 << "  --max-per-image <n>     keep at most <n> false positives per image (default 10)\n"
+		 << "  --threads <n>           number of worker threads (default: hardware threads)\n"
+		 << "  --help                  print this message\n";
+}
+
+/*
+ * Reports an option value that is not a valid number, then exits.
+ */
+static void invalid_value(const string &program, const string &option, const string &value)
+{
+	cerr << "[ERROR]: invalid value " << value << " for option " << option << endl;
+	print_usage(program);
+	exit(1);
+}
+
+static mining_config parse_mining_config(int argc, char **argv)
+{
+	mining_config config;
+	for (int i = 1; i < argc; i++)
+	{
+		try
+		{
+			string arg = argv[i];
+			bool has_value = i + 1 < argc;
+
+			if (arg == "--help")
+			{
+				print_usage(argv[0]);
+				exit(0);
+			}
+			else if (arg == "--background" && has_value)
+				config.backgrounds.push_back(argv[++i]);
+			else if (arg == "--output" && has_value)
+				config.output = string(argv[++i]) + "/";
+			else if (arg == "--in-place")
+				config.in_place = true;
+			else if (arg == "--max-per-image" && has_value)
+				config.max_per_image = parse_number<int>(argv[++i]);
+			else if (arg == "--threads" && has_value)
+				config.threads = max(1, parse_number<int>(argv[++i]));
+			else
+			{
+				cerr << "[ERROR]: invalid option " << arg << endl;
+				print_usage(argv[0]);
+				exit(1);
+			}
+		}
+		catch (const invalid_argument &)
+		{
+			invalid_value(argv[0], argv[i - 1], argv[i]);
+		}
+		catch (const out_of_range &)
+		{
+			invalid_value(argv[0], argv[i - 1], argv[i]);
+		}
+	}
+	return config;
+}
+
+/*
+ * Returns the whole content of a text file, empty if it cannot be read.
+ */
+static string read_text(const string &path)
+{
+	ifstream file(path);
+	stringstream content;
+	content << file.rdbuf();
+	return content.str();
+}
+
+/*
+ * Appends the jpg and png images of a directory to `images`.
+ */
+static void list_images(const string &dir, vector<String> &images)
+{
+	for (const string pattern : {"*.jpg", "*.png"})
+	{
+		vector<String> found;
+		glob(dir + "/" + pattern, found, false);
+		images.insert(images.end(), found.begin(), found.end());
+	}
+}
+
+int main(int argc, char **argv)
+{
+	mining_config config = parse_mining_config(argc, argv);
+	if (get_num_categories() == 0)
+	{
+		cerr << "[ERROR]: no category found in " << base << endl;
+		exit(1);
+	}
+	for (const category_info &info : get_categories())
+	{
+		const string &category = info.folder;
+		const string &name = info.name;
+		string xml = read_text(base + category + cascade);
+		int num_stages = cascade_stage_count(xml);
+		if (num_stages == 0)
+		{
+			cout << "[ERROR]: could not read the cascade of " << name << endl;
+			exit(1);
+		}
+
+		// cascades truncated to 1, 2, ... stages, the last one is the full cascade
+		vector<string> stage_xml;
+		for (int k = 1; k <= num_stages; k++)
+		{
+			stage_xml.push_back(truncate_cascade(xml, k));
+			if (stage_xml.back().empty())
+			{
+				cout << "[ERROR]: could not split the stages of the cascade of " << name << endl;
+				exit(1);
+			}
+		}
+
+		vector<String> images;
+		list_images(base + category + negative_path, images);
+		for (const string &dir : config.backgrounds)
+			list_images(dir, images);
+
+		// every worker owns its classifiers, images are taken from a shared counter
+		vector<vector<Rect>> false_positives(images.size());
+		vector<mining_stats> worker_stats(config.threads, mining_stats(num_stages));
+		atomic<size_t> next(0);
+		vector<thread> workers;
+		for (int t = 0; t < config.threads; t++)
+		{
+			workers.emplace_back([&, t]()
+			{
+				vector<CascadeClassifier> stages(num_stages);
+				for (int k = 0; k < num_stages; k++)
+				{
+					if (!load_cascade_from_memory(stages[k], stage_xml[k]))
+						return;
+				}
+				Size window = stages.back().getOriginalWindowSize();
+
+				for (size_t i = next++; i < images.size(); i = next++)
+				{
+					Mat img = imread(images[i]);
+					if (img.empty())
+						continue;
+					scan_negative(img, stages, window, worker_stats[t], false_positives[i]);
+				}
+			});
+		}
+		for (thread &worker : workers)
+			worker.join();
+
+		mining_stats stats(num_stages);
+		for (const mining_stats &s : worker_stats)
+			stats.add(s);
+		if (stats.images < images.size())
+			cout << "[ERROR]: " << images.size() - stats.images << " images of " << name << " could not be scanned" << endl;
+		stats.print(name, cout);
+
+		// write the false positive windows as new negatives, in image order
+		string category_dir = config.in_place ? base + category : config.output + category;
+		fs::create_directories(category_dir + negative_path);
+
+		vector<string> entries;
+		set<string> listed;
+		ifstream list_file(base + category + "negative.txt");
+		for (string line; getline(list_file, line);)
+		{
+			if (!line.empty() && listed.insert(line).second)
+				entries.push_back(line);
+		}
+		list_file.close();
+
+		size_t written = 0;
+		for (size_t i = 0; i < images.size(); i++)
+		{
+			if (false_positives[i].empty())
+				continue;
+			Mat img = imread(images[i]);
+			string stem = fs::path(images[i]).stem().string();
+			int count = min(static_cast<int>(false_positives[i].size()), config.max_per_image);
+			for (int k = 0; k < count; k++)
+			{
+				// the index of the image keeps images of the same stem (other extension or background folder) apart
+				string file_name = "mined_" + to_string(i) + "_" + stem + "_" + to_string(k) + ".jpg";
+				imwrite(category_dir + negative_path + file_name, img(false_positives[i][k]));
+
+				string entry = "./" + negative_path + file_name;
+				if (listed.insert(entry).second)
+					entries.push_back(entry);
+				written++;
+			}
+		}
+
+		ofstream out(category_dir + "negative.txt");
+		for (const string &entry : entries)
+			out << entry << "\n";
+		out.close();
+
+		cout << "[INFO]: " << name << ": " << written << " new negatives written to " << category_dir + negative_path << endl;
+		cout << "--------------------------------------------------\n";
+	}
+
+	return 0;
+}
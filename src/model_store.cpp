@@ -0,0 +1,183 @@
+// created by Davide Baggio 2122547
+
+#include "model_store.hpp"
+#include "memory_tracker.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// size of a huge page, blocks backed by huge pages are rounded up to it
+const static size_t huge_page_size = 2 * 1024 * 1024;
+
+model_store::~model_store()
+{
+	for (block &b : blocks)
+		release(b);
+}
+
+model_store::block model_store::allocate(size_t bytes)
+{
+	block b;
+	b.bytes = max(bytes, model_store_alignment);
+
+#ifdef __linux__
+	if (huge_pages)
+	{
+		size_t rounded = (b.bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+
+		// explicit huge pages, then transparent huge pages on a huge page aligned mapping
+		void *data = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		bool explicit_pages = data != MAP_FAILED;
+		if (!explicit_pages)
+		{
+			data = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (data != MAP_FAILED && madvise(data, rounded, MADV_HUGEPAGE) != 0)
+			{
+				munmap(data, rounded);
+				data = MAP_FAILED;
+			}
+		}
+		if (data != MAP_FAILED)
+		{
+			b.data = data;
+			b.bytes = rounded;
+			b.mapped = true;
+			b.slot = mem_record_alloc(SOURCE_MAT, b.bytes);
+			huge_pages_used = true;
+			return b;
+		}
+		cerr << "[ERROR]: huge pages not available, using regular pages for the model store" << endl;
+		huge_pages = false;
+	}
+#endif
+
+	size_t rounded = (b.bytes + model_store_alignment - 1) / model_store_alignment * model_store_alignment;
+	b.data = aligned_alloc(model_store_alignment, rounded);
+	if (b.data == nullptr)
+	{
+		cout << "[ERROR]: could not allocate " << rounded << " bytes for the model store" << endl;
+		throw bad_alloc();
+	}
+	b.bytes = rounded;
+	b.slot = mem_record_alloc(SOURCE_MAT, b.bytes);
+	return b;
+}
+
+void model_store::release(block &b)
+{
+	if (b.data == nullptr)
+		return;
+
+	mem_record_free(SOURCE_MAT, b.slot, b.bytes);
+#ifdef __linux__
+	if (b.mapped)
+		munmap(b.data, b.bytes);
+	else
+		free(b.data);
+#else
+	free(b.data);
+#endif
+	b.data = nullptr;
+}
+
+void model_store::set_huge_pages(bool enable)
+{
+	huge_pages = enable;
+}
+
+void model_store::pack(vector<vector<Mat>> &views)
+{
+	vector<block> new_blocks(views.size());
+	vector<Mat> new_descriptors(views.size());
+	vector<vector<int>> new_offsets(views.size());
+	huge_pages_used = false;
+
+	// copy every category into its block, the views may still point into the old blocks
+	for (size_t i = 0; i < views.size(); i++)
+	{
+		int rows = 0;
+		int cols = 0;
+		int type = -1;
+		new_offsets[i].push_back(0);
+		for (const Mat &view : views[i])
+		{
+			if (!view.empty())
+			{
+				cols = view.cols;
+				type = view.type();
+			}
+			rows += view.rows;
+			new_offsets[i].push_back(rows);
+		}
+		if (rows == 0)
+			continue;
+
+		size_t row_bytes = cols * CV_ELEM_SIZE(type);
+		try
+		{
+			new_blocks[i] = allocate(rows * row_bytes);
+		}
+		catch (const bad_alloc &)
+		{
+			// the blocks of the previous categories are dropped, the old ones stay in use
+			for (block &b : new_blocks)
+				release(b);
+			throw;
+		}
+		new_descriptors[i] = Mat(rows, cols, type, new_blocks[i].data, row_bytes);
+		for (size_t j = 0; j < views[i].size(); j++)
+		{
+			if (views[i][j].empty())
+				continue;
+			Mat rows_of_view = new_descriptors[i].rowRange(new_offsets[i][j], new_offsets[i][j + 1]);
+			views[i][j].copyTo(rows_of_view);
+		}
+	}
+
+	for (block &b : blocks)
+		release(b);
+	blocks.swap(new_blocks);
+	category_descriptors.swap(new_descriptors);
+	offsets.swap(new_offsets);
+
+	for (size_t i = 0; i < views.size(); i++)
+	{
+		for (size_t j = 0; j < views[i].size(); j++)
+			views[i][j] = view(static_cast<int>(i), static_cast<int>(j));
+	}
+}
+
+int model_store::num_categories() const
+{
+	return static_cast<int>(category_descriptors.size());
+}
+
+int model_store::num_views(int category) const
+{
+	return static_cast<int>(offsets[category].size()) - 1;
+}
+
+Mat model_store::view(int category, int view) const
+{
+	int begin = offsets[category][view];
+	int end = offsets[category][view + 1];
+	if (begin == end)
+		return Mat();
+	return category_descriptors[category].rowRange(begin, end);
+}
+
+size_t model_store::bytes() const
+{
+	size_t total = 0;
+	for (const block &b : blocks)
+		total += b.bytes;
+	return total;
+}
+
+bool model_store::uses_huge_pages() const
+{
+	return huge_pages_used;
+}
@@ -0,0 +1,109 @@
+// created by Davide Baggio 2122547
+
+#include "negative_mining.hpp"
+
+int cascade_stage_count(const string &xml)
+{
+	const string tag = "<stageNum>";
+	size_t begin = xml.find(tag);
+	if (begin == string::npos)
+		return 0;
+	return stoi(xml.substr(begin + tag.size()));
+}
+
+string truncate_cascade(const string &xml, int stages)
+{
+	int total = cascade_stage_count(xml);
+	if (stages <= 0 || total == 0)
+		return "";
+	if (stages >= total)
+		return xml;
+
+	size_t count_begin = xml.find("<stageNum>");
+	size_t count_end = xml.find("</stageNum>", count_begin);
+	size_t cut_begin = xml.find("<!-- stage " + to_string(stages) + " -->");
+	size_t cut_end = xml.find("</stages>");
+	if (count_end == string::npos || cut_begin == string::npos || cut_end == string::npos || cut_begin > cut_end)
+		return "";
+
+	string truncated = xml.substr(0, count_begin) + "<stageNum>" + to_string(stages) + xml.substr(count_end, cut_begin - count_end);
+	return truncated + xml.substr(cut_end);
+}
+
+bool load_cascade_from_memory(CascadeClassifier &classifier, const string &xml)
+{
+	if (xml.empty())
+		return false;
+
+	FileStorage fs(xml, FileStorage::READ | FileStorage::MEMORY);
+	if (!fs.isOpened())
+		return false;
+	return classifier.read(fs.getFirstTopLevelNode()) && !classifier.empty();
+}
+
+double count_windows(Size image, Size window, double scale_factor)
+{
+	double windows = 0;
+	for (double factor = 1.0;; factor *= scale_factor)
+	{
+		int width = cvRound(image.width / factor) - window.width;
+		int height = cvRound(image.height / factor) - window.height;
+		if (width < 0 || height < 0)
+			break;
+
+		int step = factor > 2.0 ? 1 : 2;
+		windows += static_cast<double>(width / step + 1) * (height / step + 1);
+	}
+	return windows;
+}
+
+mining_stats::mining_stats(int stages)
+{
+	stage_windows.assign(stages, 0.0);
+}
+
+void mining_stats::add(const mining_stats &other)
+{
+	images += other.images;
+	windows += other.windows;
+	false_positives += other.false_positives;
+	if (stage_windows.size() < other.stage_windows.size())
+		stage_windows.resize(other.stage_windows.size(), 0.0);
+	for (size_t k = 0; k < other.stage_windows.size(); k++)
+		stage_windows[k] += other.stage_windows[k];
+}
+
+void mining_stats::print(const string &name, ostream &out) const
+{
+	out << "[INFO]: " << name << ": " << images << " negative images, " << windows << " windows, "
+		<< false_positives << " false positives (" << false_positives / max<double>(images, 1) << " per image)" << endl;
+
+	double previous = windows;
+	for (size_t k = 0; k < stage_windows.size(); k++)
+	{
+		out << "[INFO]:   stage " << k << ": cumulative false positive rate " << stage_windows[k] / max(windows, 1.0)
+			<< ", stage false positive rate " << stage_windows[k] / max(previous, 1.0) << endl;
+		previous = stage_windows[k];
+	}
+}
+
+void scan_negative(const Mat &img, vector<CascadeClassifier> &stages, Size window, mining_stats &stats, vector<Rect> &false_positives)
+{
+	Mat gray;
+	cvtColor(img, gray, COLOR_BGR2GRAY);
+	equalizeHist(gray, gray);
+
+	stats.images++;
+	stats.windows += count_windows(gray.size(), window, cascade_scale_factor);
+
+	vector<Rect> objects;
+	for (size_t k = 0; k < stages.size(); k++)
+	{
+		// no grouping, every window that passes the stages is counted
+		stages[k].detectMultiScale(gray, objects, cascade_scale_factor, 0, CASCADE_SCALE_IMAGE);
+		stats.stage_windows[k] += objects.size();
+	}
+
+	stages.back().detectMultiScale(gray, false_positives, cascade_scale_factor, cascade_min_neighbors, CASCADE_SCALE_IMAGE);
+	stats.false_positives += false_positives.size();
+}
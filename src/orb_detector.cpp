@@ -1,12 +1,16 @@
 // Created by: Zoren Martinez mat. 2123873
 #include "orb_detector.hpp"
+#include "memory_tracker.hpp"
+#include "feature_extraction.hpp"
+#include "dataset_pack.hpp"
+#include <numeric>
 
 
 orb_detector::orb_detector()
 {
-	
 	for (int i = 0; i < models_path.size(); i++)
 	{
+		mem_scope scope(STAGE_MODEL_LOADING, i);
 		try
 		{
 			regex regex_pattern(pattern);
@@ -14,50 +18,32 @@ orb_detector::orb_detector()
 			Mat src;
 			Mat mask;
 
-			int max_matches = 0;
-			string best_match_fileName;
-			Mat best_descriptors;
-			vector<KeyPoint> best_keypoints;
-			vector<DMatch> winning_matches;
-			vector<Point> medians;
-
-			for (const auto &entry : fs::directory_iterator(models_path[i]))
+			for (const string &model_path : list_dataset(models_path[i]))
 			{
-				if (entry.is_regular_file())
-				{
+				std::string file_name = model_path.substr(model_path.find_last_of("/") + 1);
+				string file_mask = file_name.substr(0, file_name.find_last_of("_")) + "_mask.png";
 
-					std::string file_name = entry.path().filename().string();
-					
-					string file_mask = file_name.substr(file_name.find_last_of("/") + 1);
-					file_mask = file_mask.substr(0, file_mask.find_last_of("_")) + "_mask.png";
+				if (std::regex_match(file_name, regex_pattern))
+				{
+					src = read_dataset_image(model_path);
+					mask = read_dataset_image(models_path[i] + "/" + file_mask, IMREAD_GRAYSCALE);
 
-					if (std::regex_match(file_name, regex_pattern))
+					if (src.empty() || mask.empty())
 					{
-						std::string full_file_name = models_path[i] + "/" + entry.path().filename().string();
-						src = imread(full_file_name);
-						mask = imread(models_path[i] + "/" + file_mask, IMREAD_GRAYSCALE);
-
-						if (src.empty() || mask.empty())
-						{
-							std::cerr << "[ERROR]: Could not open image file: " << file_name << std::endl;
-							continue;
-						}
+						std::cerr << "[ERROR]: Could not open image file: " << file_name << std::endl;
+						continue;
+					}
 
-						Mat descriptors_1;
-						vector<KeyPoint> keypoints_1;
+					Mat descriptors_1;
+					vector<KeyPoint> keypoints_1;
 
-						Mat gray_frame;
-						cvtColor(src, gray_frame, COLOR_BGR2GRAY);
+					Mat gray_frame;
+					cvtColor(src, gray_frame, COLOR_BGR2GRAY);
 
-						orb->detect(gray_frame, keypoints_1, mask);
-						orb->compute(gray_frame, keypoints_1, descriptors_1);
+					orb->detect(gray_frame, keypoints_1, mask);
+					orb->compute(gray_frame, keypoints_1, descriptors_1);
 
-						model_descriptors[i].push_back(descriptors_1);
-					}
-				}
-				else
-				{
-					continue;
+					model_descriptors[i].push_back(descriptors_1);
 				}
 			}
 		}
@@ -66,6 +52,9 @@ orb_detector::orb_detector()
 			std::cerr << "[ERROR]: " << e.what() << std::endl;
 		}
 	}
+
+	mem_scope scope(STAGE_MODEL_LOADING);
+	models.pack(model_descriptors);
 }
 
 double orb_detector::compute_median(vector<double> values)
@@ -83,180 +72,213 @@ double orb_detector::compute_median(vector<double> values)
 }
 
 
-vector<DMatch> orb_detector::get_matches(const Mat &model_descriptors, const Mat &test_descriptors)
+void orb_detector::get_matches(const Mat &model_descriptors, const Mat &test_descriptors, vector<DMatch> &matches) const
 {
-	BFMatcher matcher(NORM_HAMMING, true);
-	vector<DMatch> matches;
-	matcher.match(model_descriptors, test_descriptors, matches);
-
-	return matches;
+	matcher->match(model_descriptors, test_descriptors, matches);
 }
 
-void orb_detector::save_points(vector<DMatch> matches, vector<KeyPoint> test_keypoints, int category)
+void orb_detector::save_points(const vector<DMatch> &matches, const vector<KeyPoint> &test_keypoints, int category, frame_result &result)
 {
-	vector<Point> matches_points;
-
+	result.begin_block(DETECTOR_ORB, category);
 	for (size_t i = 0; i < matches.size(); i++)
 	{
-		int idx1 = matches[i].queryIdx;
 		int idx2 = matches[i].trainIdx;
-		Point pt2 = test_keypoints[idx2].pt;
-
-		matches_points.push_back(pt2);
+		result.push(test_keypoints[idx2].pt, matches[i].distance);
 	}
-	points[category] = matches_points;
+	result.end_block();
 }
 
 
-vector<vector<Point>> orb_detector::get_points()
+void orb_detector::compute_detection(const Mat &img, frame_result &result)
 {
-	return points;
-}
+	mem_scope scope(STAGE_ORB);
 
+	this->test = img;
+	int64 start = getTickCount();
 
-vector<vector<Point>> orb_detector::get_points(float perc)
-{
+	// the budget bounds the cost, it never lets ORB detect more keypoints than without it
+	orb->setMaxFeatures(budget.enabled() ? min(budget.limit(), initial_max_features) : initial_max_features);
 
-	if (perc > 1.0 || perc < 0.0)
+	static const vector<Rect> no_regions;
+	const vector<Rect> &regions = use_regions ? result.get_regions() : no_regions;
+	if (tile_size > 0 && regions.empty())
 	{
-		std::cerr << "[ERROR]: Percentage must be between 0 and 1" << endl;
-		return points;
+		// large frames are processed as overlapping tiles, each keeping only the keypoints of its own part
+		make_tiles(test.size(), tile_size, tile_halo, tiles);
+		detect_in_tiles(*orb, test, tiles, test_keypoints, test_descriptors, &budget);
 	}
-
-	vector<vector<Point>> best_points;
-	for (size_t j = 0; j < points.size(); j++)
+	else
 	{
-		int max_index = points[j].size() * perc;
-		vector<Point> best_single_vector;
-		for (int i = 0; i < max_index; i++)
-		{
-			best_single_vector.push_back(points[j][i]);
-		}
-		best_points.push_back(best_single_vector);
+		detect_in_regions(*orb, test, regions, test_keypoints, test_descriptors, &budget);
 	}
-	return best_points;
-}
-
-
-void orb_detector::compute_detection(Mat img)
-{
-	this->test = img;
-
-	Mat copy = test.clone();
-
-	vector<KeyPoint> test_keypoints;
-	Mat test_descriptors;
-
-	
-	orb->detect(test, test_keypoints);
-	orb->compute(test, test_keypoints, test_descriptors);
 
 	if (test_descriptors.empty())
 	{
-		cout << "ORB: No descriptors found for tes image " << endl;
+		if (log_frames)
+			cout << "ORB: No descriptors found for tes image " << endl;
 		return;
 	}
 
-	
-	for (int i = 0; i < models_path.size(); i++)
+	// only the views that share the most visual words with the frame are matched
+	if (candidate_views > 0 && shared_views)
+	{
+		vocabulary.select_shared(test_descriptors, candidate_views, search_views);
+	}
+	else if (candidate_views > 0)
 	{
-		int max_matches = 0;
-		string best_match_fileName;
-		Mat best_descriptors;
-		vector<DMatch> winning_matches;
-		vector<Point> medians;
+		vocabulary.select_views(test_descriptors, candidate_views, search_views);
+	}
 
-		for (int j = 0; j < model_descriptors[i].size(); j++)
+	// the views of every category are matched in parallel against the shared frame descriptors
+	int num_categories = static_cast<int>(models_path.size());
+	for (int i = 0; i < num_categories; i++)
+	{
+		if (candidate_views == 0)
 		{
-			vector<DMatch> matches = get_matches(model_descriptors[i][j], test_descriptors);
+			search_views[i].resize(model_descriptors[i].size());
+			iota(search_views[i].begin(), search_views[i].end(), 0);
+		}
+		num_views[i] = search_views[i].size();
+	}
 
-			if (matches.empty())
-			{
-				cout << "ORB: No matches found for type " << i << endl;
-				continue;
-			}
+	auto match_view = [&](int i, int c, vector<DMatch> &matches)
+	{
+		mem_scope category_scope(STAGE_ORB, i);
+		get_matches(model_descriptors[i][search_views[i][c]], test_descriptors, matches);
+	};
 
-			if (matches.size() == 0)
-			{
-				cout << "ORB: Image matches below minimum threshold: " << matches.size() << endl;
-				continue;
-			}
-			
-			
-			if (matches.size() > max_matches)
-			{
-				winning_matches = matches;
-				max_matches = matches.size();
-				best_descriptors = model_descriptors[i][j];
-			}
-		}
+	if (bounded_views)
+	{
+		// the coarse subset estimates the matches of a view, a view cannot match more descriptors than it has
+		auto score_view = [&](int i, int c, size_t &estimate, size_t &bound)
+		{
+			mem_scope category_scope(STAGE_ORB, i);
+			static thread_local vector<DMatch> coarse_matches;
+			const Mat &subset = model_subsets[i][search_views[i][c]];
+			size_t rows = model_descriptors[i][search_views[i][c]].rows;
+			estimate = 0;
+			bound = min<size_t>(rows, test_descriptors.rows);
+			if (subset.empty())
+				return;
+			get_matches(subset, test_descriptors, coarse_matches);
+			estimate = coarse_matches.size() * rows / subset.rows;
+		};
+		search.run_bounded(search_views, parallel_views, parallel_categories, match_view, score_view);
+	}
+	else
+	{
+		search.run(num_views, parallel_views, parallel_categories, match_view);
+	}
 
-		if (max_matches == 0)
+	// blocks are written in category order, the frame result is not shared between tasks
+	for (int i = 0; i < num_categories; i++)
+	{
+		if (search.get_winner(i) < 0)
 		{
-			cout << "ORB: No matches found for type " << i << endl;
+			// with a shared shortlist most categories have no view to match
+			if (log_frames && !search_views[i].empty())
+				cout << "ORB: No matches found for type " << i << endl;
 			continue;
 		}
 
-		
+		vector<DMatch> &winning_matches = search.get_winning_matches(i);
 		sort(winning_matches.begin(), winning_matches.end(), [](const DMatch &a, const DMatch &b)
 			 { return a.distance < b.distance; });
-		
-		save_points(winning_matches, test_keypoints, i);
+		save_points(winning_matches, test_keypoints, i, result);
+	}
+	budget.record_frame(test_keypoints.size(), (getTickCount() - start) / getTickFrequency());
+	if (log_frames)
+		cout << "Best matches found from ORB detector\n";
+}
+
+void orb_detector::set_view_preselection(int views, bool shared)
+{
+	mem_scope scope(STAGE_MODEL_LOADING);
+	candidate_views = views;
+	shared_views = shared;
+	if (views > 0 && vocabulary.empty())
+	{
+		vocabulary.build(model_descriptors, true);
+		cout << "[INFO]: ORB vocabulary of " << vocabulary.get_num_words() << " words" << endl;
+	}
+}
+
+void orb_detector::set_bounded_views(bool enable)
+{
+	mem_scope scope(STAGE_MODEL_LOADING);
+	bounded_views = enable;
+	model_subsets.assign(model_descriptors.size(), vector<Mat>());
+	if (!enable)
+		return;
+
+	size_t subset_bytes = 0;
+	for (size_t i = 0; i < model_descriptors.size(); i++)
+	{
+		for (const Mat &view : model_descriptors[i])
+		{
+			model_subsets[i].push_back(view_search::coarse_subset(view));
+			subset_bytes += model_subsets[i].back().total() * model_subsets[i].back().elemSize();
+		}
 	}
-	cout << "Best matches found from ORB detector\n";
+	cout << "[INFO]: ORB coarse view subsets of " << subset_bytes / 1024 << " KB" << endl;
 }
 
-void orb_detector::display_points()
+const view_search &orb_detector::get_view_search() const
 {
-	display_points(1.0);
+	return search;
 }
 
-void orb_detector::display_points(float perc)
+void orb_detector::set_huge_pages(bool enable)
 {
+	mem_scope scope(STAGE_MODEL_LOADING);
+	models.set_huge_pages(enable);
+	models.pack(model_descriptors);
+	cout << "[INFO]: ORB model store of " << models.bytes() / 1024 << " KB" << (models.uses_huge_pages() ? " on huge pages" : "") << endl;
+}
 
-	vector<Mat> mat_matches = vector<Mat>(3);
-	mat_matches[0] = test.clone(); // sugar
-	mat_matches[1] = test.clone(); // mustard
-	mat_matches[2] = test.clone(); // drill
+void orb_detector::set_budget(double budget_ms, int max_keypoints)
+{
+	budget = feature_budget(budget_ms, max_keypoints);
+}
 
-	vector<vector<Point>> pp = get_points(perc);
+const feature_budget &orb_detector::get_budget() const
+{
+	return budget;
+}
+
+void orb_detector::display_points(const frame_result &result)
+{
+	display_points(result, 1.0);
+}
 
-	for (size_t i = 0; i < pp.size(); i++)
+void orb_detector::display_points(const frame_result &result, float perc)
+{
+
+	vector<Mat> &mat_matches = display_frames;
+	for (Mat &frame : mat_matches)
+		test.copyTo(frame);
+
+	for (size_t i = 0; i < mat_matches.size(); i++)
 	{
-		if (points[i].size() == 0)
+		if (result.view(DETECTOR_ORB, i).empty())
 		{
 			cout << "ORB: No points found for type " << i << endl;
 			continue;
 		}
-		for (int j = 0; j < pp[i].size(); j++)
+		for (const Point &pt : result.top(DETECTOR_ORB, i, perc))
 		{
-			Point pt = pp[i][j];
 			circle(mat_matches[i], pt, 5, Scalar(0, 255, 0), 2);
 		}
 	}
 
 	for (int i = 0; i < mat_matches.size(); i++)
 	{
-
-		string category;
-		if (i == 0)
-		{
-			category = "sugar_box";
-		}
-		else if (i == 1)
-		{
-			category = "mustard_bottle";
-		}
-		else if (i == 2)
-		{
-			category = "power_drill";
-		}
 		if (mat_matches[i].empty())
 		{
 			cout << "ORB: No matches found for type " << i << endl;
 			continue;
 		}
-		imshow(category + " matches", mat_matches[i]);
+		imshow(get_categories()[i].name + " matches", mat_matches[i]);
 	}
 	waitKey(0);
 }
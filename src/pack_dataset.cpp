@@ -0,0 +1,62 @@
+// created by Davide Baggio 2122547
+
+#include "dataset_pack.hpp"
+#include <filesystem>
+
+namespace fs = filesystem;
+
+static void print_usage(const string &program)
+{
+	cout << "Usage: " << program << " [--raw] <data_dir> <pack_file>\n"
+		 << "  --raw                   store the images decoded, so they are read without decoding\n"
+		 << "  --help                  print this message\n";
+}
+
+int main(int argc, char **argv)
+{
+	bool raw_images = false;
+	vector<string> paths;
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if (arg == "--help")
+		{
+			print_usage(argv[0]);
+			exit(0);
+		}
+		else if (arg == "--raw")
+			raw_images = true;
+		else if (arg[0] == '-')
+		{
+			cerr << "[ERROR]: invalid option " << arg << endl;
+			print_usage(argv[0]);
+			exit(1);
+		}
+		else
+			paths.push_back(arg);
+	}
+
+	if (paths.size() != 2)
+	{
+		print_usage(argv[0]);
+		exit(1);
+	}
+	if (!fs::is_directory(paths[0]))
+	{
+		cerr << "[ERROR]: " << paths[0] << " is not a directory" << endl;
+		exit(1);
+	}
+
+	cout << "[INFO]: Packing " << paths[0] << " into " << paths[1] << (raw_images ? " (raw images)" : "") << "\n";
+	if (!dataset_pack::write(paths[0], paths[1], raw_images))
+		exit(1);
+
+	dataset_pack pack;
+	if (!pack.open(paths[1]))
+	{
+		cerr << "[ERROR]: could not read back the pack " << paths[1] << endl;
+		exit(1);
+	}
+	cout << "[INFO]: Packed " << fs::file_size(paths[1]) << " bytes\n";
+	return 0;
+}
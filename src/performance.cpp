@@ -1,9 +1,61 @@
 // created by Davide Baggio 2122547
 
 #include "detection.hpp"
+#include "dataset_pack.hpp"
+#include "category_table.hpp"
+
+static void print_usage(const string &program)
+{
+	cout << "Usage: " << program << " [options]\n"
+		 << "  --pack <file>           read the labels from a pack written by pack_dataset\n"
+		 << "  --annotations <format>  format of the annotations of the last run, jsonl or text (default jsonl)\n"
+		 << "  --help                  print this message\n";
+}
 
 int main(int argc, char **argv)
 {
-	display_performances();
+	annotation_format format = ANNOTATIONS_JSONL;
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		bool has_value = i + 1 < argc;
+
+		if (arg == "--help")
+		{
+			print_usage(argv[0]);
+			exit(0);
+		}
+		else if (arg == "--pack" && has_value)
+		{
+			// optional dataset pack the labels are read from
+			if (!open_dataset_pack(argv[++i]))
+			{
+				cerr << "[ERROR]: could not open the dataset pack " << argv[i] << endl;
+				exit(1);
+			}
+		}
+		else if (arg == "--annotations" && has_value)
+		{
+			if (!parse_annotation_format(argv[++i], format))
+			{
+				cerr << "[ERROR]: unknown annotation format " << argv[i] << endl;
+				exit(1);
+			}
+		}
+		else
+		{
+			cerr << "[ERROR]: invalid option " << arg << endl;
+			print_usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (get_num_categories() == 0)
+	{
+		cerr << "[ERROR]: no category found in " << base << endl;
+		exit(1);
+	}
+
+	display_performances(format);
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,295 @@
+// created by Davide Baggio 2122547
+
+#include "pipeline_config.hpp"
+#include "descriptor_codec.hpp"
+#include "detection.hpp"
+#include "option_value.hpp"
+#include <cstdlib>
+#include <sstream>
+
+/*
+ * Parses a comma separated list of names, such as "haar,lbp,haar".
+ */
+static vector<string> parse_string_list(const string &list)
+{
+	vector<string> values;
+	stringstream ss(list);
+	string value;
+	while (getline(ss, value, ','))
+	{
+		if (!value.empty())
+			values.push_back(value);
+	}
+	return values;
+}
+
+/*
+ * Parses a comma separated list of floats, such as "1,0.75,0.5".
+ */
+static vector<float> parse_float_list(const string &list)
+{
+	vector<float> values;
+	stringstream ss(list);
+	string value;
+	while (getline(ss, value, ','))
+	{
+		if (!value.empty())
+			values.push_back(parse_number<float>(value));
+	}
+	return values;
+}
+
+void print_usage(const string &program)
+{
+	cout << "Usage: " << program << " [options]\n"
+		 << "  --mem-report            print per-stage memory accounting at exit\n"
+		 << "  --mem-sample <ms>       print a memory sample every <ms> milliseconds\n"
+		 << "  --mat-pool <mb>         memory kept to recycle frame-sized Mat buffers across frames (default 0, off)\n"
+		 << "  --cascade <threshold>   skip the remaining detectors once every category reaches the confidence\n"
+		 << "  --cascade-points <n>    cluster size that gives full confidence (default 20)\n"
+		 << "  --roi <expand>          extract ORB/SIFT features only in the HAAR detections, expanded by <expand>\n"
+		 << "  --scale <s>             run the detectors on the frame resized by <s> (0 < s <= 1)\n"
+		 << "  --full-decode           decode the frames at native resolution even when --scale allows a reduced decode\n"
+		 << "  --refine [expand]       refine the boxes at native resolution, searching them expanded by [expand] (default 0.25)\n"
+		 << "  --scale-sweep <list>    print the latency/IoU curve over a comma separated list of scales\n"
+		 << "  --feature-budget <ms>   limit the ORB/SIFT keypoints to the strongest that fit in <ms> per frame\n"
+		 << "  --max-keypoints <n>     maximum number of ORB/SIFT keypoints kept by the budget (default 2000)\n"
+		 << "  --views <k>             match only the <k> model views per category preselected by the vocabulary tree\n"
+		 << "  --shared-views <k>      match only the <k> best model views of all categories, ranked by the vocabulary tree\n"
+		 << "  --sift-descriptors <m>  store and match SIFT descriptors as float, uint8, pca32 or pca64 (default float)\n"
+		 << "  --huge-pages            allocate the model descriptor stores on huge pages\n"
+		 << "  --cascade-types <list>  cascade features of each category, such as haar,lbp,haar (default haar)\n"
+		 << "  --cascade-benchmark     print the latency/IoU of the HAAR and LBP cascades of every category\n"
+		 << "  --serial-categories     process the categories of a frame one after another instead of in parallel\n"
+		 << "  --serial-views          match the model views of a category one after another\n"
+		 << "  --bounded-views         stop matching the views of a category once the others cannot win\n"
+		 << "  --tile <px>             process frames larger than <px> as overlapping tiles in parallel\n"
+		 << "  --tile-halo <px>        pixels processed around the part of the frame each tile owns (default 128)\n"
+		 << "  --annotations <format>  write the annotations as jsonl (one file per run) or text (one file per frame)\n"
+		 << "  --quiet                 do not print the per-frame lines of the detectors\n"
+		 << "  --pack <file>           read the dataset from a pack written by pack_dataset\n"
+		 << "  --daemon <socket>       load the models once and serve detection requests on a Unix domain socket\n"
+		 << "  --daemon-workers <n>    frames the daemon processes at once, each worker loads its own detectors (default 1)\n"
+		 << "  --help                  print this message\n";
+}
+
+/*
+ * Reports an option value that is not a valid number, then exits.
+ */
+static void invalid_value(const string &program, const string &option, const string &value)
+{
+	cerr << "[ERROR]: invalid value " << value << " for option " << option << endl;
+	print_usage(program);
+	exit(1);
+}
+
+pipeline_config parse_config(int argc, char **argv)
+{
+	pipeline_config config;
+
+	for (int i = 1; i < argc; i++)
+	{
+		try
+		{
+			string arg = argv[i];
+			bool has_value = i + 1 < argc;
+
+			if (arg == "--help")
+			{
+				print_usage(argv[0]);
+				exit(0);
+			}
+			else if (arg == "--mem-report")
+			{
+				config.mem_report = true;
+			}
+			else if (arg == "--mem-sample" && has_value)
+			{
+				config.mem_sample_ms = parse_number<unsigned>(argv[++i]);
+			}
+			else if (arg == "--mat-pool" && has_value)
+			{
+				config.mat_pool_mb = parse_number<size_t>(argv[++i]);
+			}
+			else if (arg == "--cascade" && has_value)
+			{
+				config.cascade = true;
+				config.cascade_threshold = parse_number<float>(argv[++i]);
+			}
+			else if (arg == "--cascade-points" && has_value)
+			{
+				config.cascade_target_points = parse_number<int>(argv[++i]);
+			}
+			else if (arg == "--roi" && has_value)
+			{
+				config.roi_expand = parse_number<float>(argv[++i]);
+			}
+			else if (arg == "--scale" && has_value)
+			{
+				config.scale = parse_number<float>(argv[++i]);
+			}
+			else if (arg == "--full-decode")
+			{
+				config.full_decode = true;
+			}
+			else if (arg == "--refine")
+			{
+				config.refine = true;
+				if (has_value && argv[i + 1][0] != '-')
+					config.refine_expand = parse_number<float>(argv[++i]);
+			}
+			else if (arg == "--scale-sweep" && has_value)
+			{
+				config.scale_sweep = parse_float_list(argv[++i]);
+			}
+			else if (arg == "--feature-budget" && has_value)
+			{
+				config.feature_budget_ms = parse_number<double>(argv[++i]);
+			}
+			else if (arg == "--max-keypoints" && has_value)
+			{
+				config.max_keypoints = parse_number<int>(argv[++i]);
+			}
+			else if (arg == "--views" && has_value)
+			{
+				config.candidate_views = parse_number<int>(argv[++i]);
+			}
+			else if (arg == "--shared-views" && has_value)
+			{
+				config.candidate_views = parse_number<int>(argv[++i]);
+				config.shared_views = true;
+			}
+			else if (arg == "--sift-descriptors" && has_value)
+			{
+				config.sift_descriptors = argv[++i];
+			}
+			else if (arg == "--huge-pages")
+			{
+				config.huge_pages = true;
+			}
+			else if (arg == "--cascade-types" && has_value)
+			{
+				config.cascade_types = parse_string_list(argv[++i]);
+			}
+			else if (arg == "--cascade-benchmark")
+			{
+				config.cascade_benchmark = true;
+			}
+			else if (arg == "--serial-categories")
+			{
+				config.parallel_categories = false;
+			}
+			else if (arg == "--serial-views")
+			{
+				config.parallel_views = false;
+			}
+			else if (arg == "--bounded-views")
+			{
+				config.bounded_views = true;
+			}
+			else if (arg == "--tile" && has_value)
+			{
+				config.tile_size = parse_number<int>(argv[++i]);
+			}
+			else if (arg == "--tile-halo" && has_value)
+			{
+				config.tile_halo = parse_number<int>(argv[++i]);
+			}
+			else if (arg == "--annotations" && has_value)
+			{
+				config.annotations = argv[++i];
+			}
+			else if (arg == "--quiet")
+			{
+				config.frame_log = false;
+			}
+			else if (arg == "--pack" && has_value)
+			{
+				config.dataset_pack = argv[++i];
+			}
+			else if (arg == "--daemon" && has_value)
+			{
+				config.daemon_socket = argv[++i];
+			}
+			else if (arg == "--daemon-workers" && has_value)
+			{
+				config.daemon_workers = parse_number<int>(argv[++i]);
+			}
+			else
+			{
+				cerr << "[ERROR]: invalid option " << arg << endl;
+				print_usage(argv[0]);
+				exit(1);
+			}
+		}
+		catch (const invalid_argument &)
+		{
+			invalid_value(argv[0], argv[i - 1], argv[i]);
+		}
+		catch (const out_of_range &)
+		{
+			invalid_value(argv[0], argv[i - 1], argv[i]);
+		}
+	}
+
+	for (float scale : config.scale_sweep)
+	{
+		if (scale <= 0.0f || scale > 1.0f)
+		{
+			cerr << "[ERROR]: scales must be in (0, 1]" << endl;
+			exit(1);
+		}
+	}
+	if (config.scale <= 0.0f || config.scale > 1.0f)
+	{
+		cerr << "[ERROR]: scale must be in (0, 1]" << endl;
+		exit(1);
+	}
+
+	for (const string &name : config.cascade_types)
+	{
+		cascade_type type;
+		if (!parse_cascade_type(name, type))
+		{
+			cerr << "[ERROR]: unknown cascade type " << name << endl;
+			exit(1);
+		}
+	}
+
+	annotation_format format;
+	if (!parse_annotation_format(config.annotations, format))
+	{
+		cerr << "[ERROR]: unknown annotation format " << config.annotations << endl;
+		exit(1);
+	}
+
+	descriptor_mode mode;
+	int dims;
+	if (!parse_descriptor_mode(config.sift_descriptors, mode, dims))
+	{
+		cerr << "[ERROR]: unknown SIFT descriptor mode " << config.sift_descriptors << endl;
+		exit(1);
+	}
+	if (config.tile_size < 0 || config.tile_halo < 0)
+	{
+		cerr << "[ERROR]: the tile size and halo must be non negative" << endl;
+		exit(1);
+	}
+	if (config.daemon_workers < 1)
+	{
+		cerr << "[ERROR]: the daemon needs at least one worker" << endl;
+		exit(1);
+	}
+	if (config.candidate_views < 0)
+	{
+		cerr << "[ERROR]: the number of views must be non negative" << endl;
+		exit(1);
+	}
+	if (config.feature_budget_ms < 0.0 || config.max_keypoints <= 0)
+	{
+		cerr << "[ERROR]: the feature budget must be non negative and the maximum number of keypoints positive" << endl;
+		exit(1);
+	}
+
+	return config;
+}
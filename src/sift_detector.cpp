@@ -1,11 +1,19 @@
 // Created by: Pivotto Francesco mat. 2158296
 #include "sift_detector.hpp"
+#include "memory_tracker.hpp"
+#include "feature_extraction.hpp"
+#include "dataset_pack.hpp"
+#include <numeric>
+
+// ratio of the Lowe's test applied to the 2 nearest neighbours of each model descriptor
+const static float match_ratio = 0.999f;
 
 void sift_detector::get_model_descriptors()
 {
 
 	for (int i = 0; i < models_path.size(); i++)
 	{
+		mem_scope scope(STAGE_MODEL_LOADING, i);
 		try
 		{
 			regex regex_pattern(pattern);
@@ -13,37 +21,34 @@ void sift_detector::get_model_descriptors()
 			Mat model;
 			Mat mask;
 
-			for (const auto &entry : directory_iterator(models_path[i]))
+			for (const string &model_path : list_dataset(models_path[i]))
 			{
-				if (entry.is_regular_file())
+				string file_name = model_path.substr(model_path.find_last_of("/") + 1);
+				string file_mask = file_name.substr(file_name.find_last_of("/") + 1);
+				file_mask = file_mask.substr(0, file_mask.find_last_of("_")) + "_mask.png";
+
+				if (regex_match(file_name, regex_pattern))
 				{
-					string file_name = entry.path().filename().string();
-					string file_mask = file_name.substr(file_name.find_last_of("/") + 1);
-					file_mask = file_mask.substr(0, file_mask.find_last_of("_")) + "_mask.png";
+					model = read_dataset_image(model_path);
+					mask = read_dataset_image(models_path[i] + "/" + file_mask, IMREAD_GRAYSCALE);
 
-					if (regex_match(file_name, regex_pattern))
+					if (model.empty() || mask.empty())
 					{
-						string full_file_name = models_path[i] + "/" + entry.path().filename().string();
-
-						model = imread(full_file_name);
-						mask = imread(models_path[i] + "/" + file_mask, IMREAD_GRAYSCALE);
-
-						if (model.empty() || mask.empty())
-						{
-							cerr << "[ERROR]: Could not open image file: " << file_name << " [SIFT]" << endl;
-							continue;
-						}
+						cerr << "[ERROR]: Could not open image file: " << file_name << " [SIFT]" << endl;
+						continue;
+					}
 
-						Mat model_desc;
-						vector<KeyPoint> model_kpt;
+					Mat model_desc;
+					vector<KeyPoint> model_kpt;
 
-						optimize_image(model);
+					Mat model_opt;
+					optimize_image(model, model_opt);
+					model = model_opt;
 
-						sift->detect(model, model_kpt, mask);
-						sift->compute(model, model_kpt, model_desc);
+					sift->detect(model, model_kpt, mask);
+					sift->compute(model, model_kpt, model_desc);
 
-						model_descriptors[i].push_back(model_desc);
-					}
+					model_descriptors[i].push_back(model_desc);
 				}
 			}
 		}
@@ -52,51 +57,53 @@ void sift_detector::get_model_descriptors()
 			cerr << "[ERROR]: " << e.what() << endl;
 		}
 	}
+
+	mem_scope scope(STAGE_MODEL_LOADING);
+	models.pack(model_descriptors);
 }
 
-void sift_detector::optimize_image(Mat &src)
+void sift_detector::optimize_image(const Mat &src, Mat &dst)
 {
-	Mat img_gray, img_equalized;
-
-	cvtColor(src, img_gray, cv::COLOR_BGR2GRAY);
-
-	equalizeHist(img_gray, img_equalized);
+	cvtColor(src, dst, cv::COLOR_BGR2GRAY);
 
-	src = img_equalized.clone();
+	equalizeHist(dst, dst);
 }
 
-void sift_detector::save_points(vector<DMatch> &matches, vector<KeyPoint> &img_kpt, int category)
+void sift_detector::save_points(const vector<DMatch> &matches, const vector<KeyPoint> &img_kpt, int category, frame_result &result)
 {
-	vector<Point> matches_points;
-
+	result.begin_block(DETECTOR_SIFT, category);
 	for (size_t i = 0; i < matches.size(); i++)
 	{
 		int i_img_point = matches[i].trainIdx;
-
-		Point img_point = img_kpt[i_img_point].pt;
-
-		matches_points.push_back(img_point);
+		result.push(img_kpt[i_img_point].pt, matches[i].distance);
 	}
-
-	points[category] = matches_points;
+	result.end_block();
 }
 
-vector<DMatch> sift_detector::get_matches(const Mat &model_desc, const Mat &img_desc)
+void sift_detector::get_matches(const Mat &model_desc, const Mat &img_desc, vector<DMatch> &good_matches) const
 {
-	FlannBasedMatcher matcher;
-	vector<vector<DMatch>> knn_matches;
-	matcher.knnMatch(model_desc, img_desc, knn_matches, 2);
+	// neighbours of the calling thread, reused across views and frames
+	static thread_local vector<vector<DMatch>> knn_matches;
+	if (codec.compact())
+	{
+		codec.knn_match(model_desc, img_desc, knn_matches, 2);
+	}
+	else
+	{
+		// exact search: the randomized kd-trees of FLANN draw from the global rand(), so parallel tasks would
+		// interleave its sequence and the matches would depend on the scheduling and differ from a serial run
+		BFMatcher matcher(NORM_L2);
+		matcher.knnMatch(model_desc, img_desc, knn_matches, 2);
+	}
 
-	vector<DMatch> good_matches;
+	good_matches.clear();
 	for (const auto &m : knn_matches)
 	{
-		if (m.size() == 2 && m[0].distance < 0.999f * m[1].distance)
+		if (m.size() == 2 && m[0].distance < match_ratio * m[1].distance)
 		{
 			good_matches.push_back(m[0]);
 		}
 	}
-
-	return good_matches;
 }
 
 sift_detector::sift_detector()
@@ -105,139 +112,236 @@ sift_detector::sift_detector()
 	get_model_descriptors();
 }
 
-void sift_detector::compute_detection(Mat img)
+void sift_detector::compute_detection(const Mat &img, frame_result &result)
 {
-	img_test = img;
+	mem_scope scope(STAGE_SIFT);
 
-	Mat img_opt = img_test.clone();
-	optimize_image(img_opt);
+	img_test = img;
 
-	vector<KeyPoint> img_kpt;
-	Mat img_desc;
+	optimize_image(img_test, img_opt);
 
-	sift->detect(img_opt, img_kpt);
-	sift->compute(img_opt, img_kpt, img_desc);
+	int64 start = getTickCount();
+	static const vector<Rect> no_regions;
+	const vector<Rect> &regions = use_regions ? result.get_regions() : no_regions;
+	if (tile_size > 0 && regions.empty())
+	{
+		// large frames are processed as overlapping tiles, each keeping only the keypoints of its own part
+		make_tiles(img_opt.size(), tile_size, tile_halo, tiles);
+		detect_in_tiles(*sift, img_opt, tiles, img_kpt, img_desc, &budget);
+	}
+	else
+	{
+		detect_in_regions(*sift, img_opt, regions, img_kpt, img_desc, &budget);
+	}
 
 	if (img_desc.empty())
 	{
-		cout << "[ERROR]: No descriptors found for test image [SIFT]" << endl;
+		if (log_frames)
+			cout << "[ERROR]: No descriptors found for test image [SIFT]" << endl;
 		return;
 	}
+	img_desc = codec.encode(img_desc);
 
-	vector<DMatch> winning_matches;
+	// only the views that share the most visual words with the frame are matched
+	if (candidate_views > 0 && shared_views)
+	{
+		vocabulary.select_shared(img_desc, candidate_views, search_views);
+	}
+	else if (candidate_views > 0)
+	{
+		vocabulary.select_views(img_desc, candidate_views, search_views);
+	}
 
-	for (int i = 0; i < model_descriptors.size(); i++)
+	// the views of every category are matched in parallel against the shared frame descriptors
+	int num_categories = static_cast<int>(model_descriptors.size());
+	for (int i = 0; i < num_categories; i++)
 	{
-		int max_matches = 0;
-		for (int j = 0; j < model_descriptors[i].size(); j++)
+		if (candidate_views == 0)
 		{
-			vector<DMatch> matches = get_matches(model_descriptors[i][j], img_desc);
-
-			if (matches.empty())
-			{
-				cout << "[ERROR]: No matches found for type " << i << " [SIFT]" << endl;
-				continue;
-			}
+			search_views[i].resize(model_descriptors[i].size());
+			iota(search_views[i].begin(), search_views[i].end(), 0);
+		}
+		num_views[i] = search_views[i].size();
+	}
 
-			if (matches.size() == 0)
-			{
-				cout << "[ERROR]: Image matches below minimum threshold: " << matches.size() << " [SIFT]" << endl;
-				continue;
-			}
+	auto match_view = [&](int i, int c, vector<DMatch> &matches)
+	{
+		mem_scope category_scope(STAGE_SIFT, i);
+		get_matches(model_descriptors[i][search_views[i][c]], img_desc, matches);
+	};
 
-			if (matches.size() > max_matches)
-			{
-				winning_matches = matches;
-				max_matches = matches.size();
-			}
-		}
+	if (bounded_views)
+	{
+		// the coarse subset estimates the matches of a view, a view cannot match more descriptors than it has
+		auto score_view = [&](int i, int c, size_t &estimate, size_t &bound)
+		{
+			mem_scope category_scope(STAGE_SIFT, i);
+			static thread_local vector<DMatch> coarse_matches;
+			const Mat &subset = model_subsets[i][search_views[i][c]];
+			size_t rows = model_descriptors[i][search_views[i][c]].rows;
+			estimate = 0;
+			bound = rows;
+			if (subset.empty())
+				return;
+			get_matches(subset, img_desc, coarse_matches);
+			estimate = coarse_matches.size() * rows / subset.rows;
+		};
+		search.run_bounded(search_views, parallel_views, parallel_categories, match_view, score_view);
+	}
+	else
+	{
+		search.run(num_views, parallel_views, parallel_categories, match_view);
+	}
 
-		if (max_matches == 0)
+	// blocks are written in category order, the frame result is not shared between tasks
+	for (int i = 0; i < num_categories; i++)
+	{
+		if (search.get_winner(i) < 0)
 		{
-			cout << "[ERROR]: No matches found for type " << i << " [SIFT]" << endl;
+			// with a shared shortlist most categories have no view to match
+			if (log_frames && !search_views[i].empty())
+				cout << "[ERROR]: No matches found for type " << i << " [SIFT]" << endl;
 			continue;
 		}
 
+		vector<DMatch> &winning_matches = search.get_winning_matches(i);
 		sort(winning_matches.begin(), winning_matches.end(), [](const DMatch &a, const DMatch &b)
 			 { return a.distance < b.distance; });
-		save_points(winning_matches, img_kpt, i);
+		save_points(winning_matches, img_kpt, i, result);
 	}
 
-	cout << "Best matches found from SIFT detector\n";
+	budget.record_frame(img_kpt.size(), (getTickCount() - start) / getTickFrequency());
+	if (log_frames)
+		cout << "Best matches found from SIFT detector\n";
 }
 
-vector<vector<Point>> sift_detector::get_points()
+void sift_detector::set_view_preselection(int views, bool shared)
 {
-	return points;
+	mem_scope scope(STAGE_MODEL_LOADING);
+	candidate_views = views;
+	shared_views = shared;
+	if (views > 0 && vocabulary.empty())
+	{
+		vocabulary.build(model_descriptors, false);
+		cout << "[INFO]: SIFT vocabulary of " << vocabulary.get_num_words() << " words" << endl;
+	}
+}
+
+void sift_detector::set_descriptor_mode(descriptor_mode mode, int dims)
+{
+	mem_scope scope(STAGE_MODEL_LOADING);
+	if (codec.compact())
+	{
+		cerr << "[ERROR]: SIFT model descriptors are already compact [SIFT]" << endl;
+		return;
+	}
+
+	descriptor_codec compact_codec(mode, dims);
+	if (!compact_codec.compact())
+		return;
+	compact_codec.train(model_descriptors);
+
+	float recall = compact_codec.measure_recall(model_descriptors, match_ratio);
+	size_t float_bytes = 0;
+	size_t compact_bytes = 0;
+	for (vector<Mat> &views : model_descriptors)
+	{
+		for (Mat &view : views)
+		{
+			float_bytes += view.total() * view.elemSize();
+			view = compact_codec.encode(view);
+			compact_bytes += view.total() * view.elemSize();
+		}
+	}
+	codec = compact_codec;
+	models.pack(model_descriptors);
+
+	// the vocabulary must quantize the same representation the frames are matched in
+	if (!vocabulary.empty())
+		vocabulary.build(model_descriptors, false);
+	if (bounded_views)
+		set_bounded_views(true);
+
+	cout << "[INFO]: SIFT " << codec.name() << " model descriptors: " << float_bytes / 1024 << " KB -> " << compact_bytes / 1024
+		 << " KB, match recall " << 100.0 * recall << "%" << endl;
 }
 
-vector<vector<Point>> sift_detector::get_points(float perc)
+void sift_detector::set_bounded_views(bool enable)
 {
-	vector<vector<Point>> best_points;
-	for (size_t j = 0; j < points.size(); j++)
+	mem_scope scope(STAGE_MODEL_LOADING);
+	bounded_views = enable;
+	model_subsets.assign(model_descriptors.size(), vector<Mat>());
+	if (!enable)
+		return;
+
+	size_t subset_bytes = 0;
+	for (size_t i = 0; i < model_descriptors.size(); i++)
 	{
-		int max_index = points[j].size() * perc;
-		vector<Point> best_single_vector;
-		for (int i = 0; i < max_index; i++)
+		for (const Mat &view : model_descriptors[i])
 		{
-			best_single_vector.push_back(points[j][i]);
+			model_subsets[i].push_back(view_search::coarse_subset(view));
+			subset_bytes += model_subsets[i].back().total() * model_subsets[i].back().elemSize();
 		}
-		best_points.push_back(best_single_vector);
 	}
-	return best_points;
+	cout << "[INFO]: SIFT coarse view subsets of " << subset_bytes / 1024 << " KB" << endl;
 }
 
-void sift_detector::display_points()
+const view_search &sift_detector::get_view_search() const
 {
-	display_points(1.0);
+	return search;
 }
 
-void sift_detector::display_points(float perc)
+void sift_detector::set_huge_pages(bool enable)
 {
+	mem_scope scope(STAGE_MODEL_LOADING);
+	models.set_huge_pages(enable);
+	models.pack(model_descriptors);
+	cout << "[INFO]: SIFT model store of " << models.bytes() / 1024 << " KB" << (models.uses_huge_pages() ? " on huge pages" : "") << endl;
+}
 
-	vector<Mat> mat_matches = vector<Mat>(3);
-	mat_matches[0] = img_test.clone();
-	mat_matches[1] = img_test.clone();
-	mat_matches[2] = img_test.clone();
+void sift_detector::set_budget(double budget_ms, int max_keypoints)
+{
+	budget = feature_budget(budget_ms, max_keypoints);
+}
 
-	vector<vector<Point>> pp = get_points(perc);
+const feature_budget &sift_detector::get_budget() const
+{
+	return budget;
+}
+
+void sift_detector::display_points(const frame_result &result)
+{
+	display_points(result, 1.0);
+}
 
-	for (size_t i = 0; i < pp.size(); i++)
+void sift_detector::display_points(const frame_result &result, float perc)
+{
+
+	vector<Mat> &mat_matches = display_frames;
+	for (Mat &frame : mat_matches)
+		img_test.copyTo(frame);
+
+	for (size_t i = 0; i < mat_matches.size(); i++)
 	{
-		if (points[i].size() == 0)
+		if (result.view(DETECTOR_SIFT, i).empty())
 		{
 			cout << "[ERROR]: No points found for type " << i << " [SIFT]" << endl;
 			continue;
 		}
-		for (int j = 0; j < pp[i].size(); j++)
+		for (const Point &pt : result.top(DETECTOR_SIFT, i, perc))
 		{
-			Point pt = pp[i][j];
 			circle(mat_matches[i], pt, 5, Scalar(0, 255, 0), 2);
 		}
 	}
 
 	for (int i = 0; i < mat_matches.size(); i++)
 	{
-
-		string category;
-		if (i == 0)
-		{
-			category = "sugar_box";
-		}
-		else if (i == 1)
-		{
-			category = "mustard_bottle";
-		}
-		else if (i == 2)
-		{
-			category = "power_drill";
-		}
 		if (mat_matches[i].empty())
 		{
 			cout << "[ERROR]: No matches found for type " << i << " [SIFT]" << endl;
 			continue;
 		}
-		imshow(category + " matches", mat_matches[i]);
+		imshow(get_categories()[i].name + " matches", mat_matches[i]);
 	}
 	waitKey(0);
 }
\ No newline at end of file
@@ -0,0 +1,356 @@
+// created by Davide Baggio 2122547
+
+#include "haar_detector.hpp"
+#include "orb_detector.hpp"
+#include "sift_detector.hpp"
+#include "detection_pipeline.hpp"
+#include "fusion_cache.hpp"
+#include "frame_decoder.hpp"
+#include "dataset_pack.hpp"
+#include "category_tasks.hpp"
+#include "category_table.hpp"
+#include "option_value.hpp"
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <sstream>
+
+/*
+ * Options of the sweep tool.
+ */
+struct sweep_config
+{
+	// pack the dataset is read from, empty reads the data directory
+	string dataset_pack;
+	// scale the detectors run at, as `--scale` of the pipeline
+	float scale = 1.0f;
+	// file the detector outputs are cached in, and whether to run the detectors even if it is valid
+	string cache = "output/fusion.cache";
+	bool rebuild = false;
+	// number of random settings, 0 evaluates the whole grid
+	int samples = 0;
+	unsigned int seed = 1;
+	// number of best settings printed
+	int top = 10;
+
+	// values of each parameter: the grid, or the range of the random search
+	vector<float> eps = {45, 50, 55, 60, 65};
+	vector<float> min_weight = {2, 3, 4, 5};
+	vector<float> fractions[DETECTOR_COUNT] = {{1.0f}, {0.2f, 0.3f, 0.4f, 0.5f}, {0.2f, 0.3f, 0.4f, 0.5f}};
+	vector<float> weights[DETECTOR_COUNT] = {{0.5f}, {1.0f}, {0.5f, 1.0f}};
+};
+
+static void print_usage(const string &program)
+{
+	cout << "Usage: " << program << " [options]\n"
+		 << "  --pack <file>           read the dataset from a pack written by pack_dataset\n"
+		 << "  --scale <s>             run the detectors on the frame resized by <s> (0 < s <= 1)\n"
+		 << "  --cache <file>          file of the cached detector outputs (default output/fusion.cache)\n"
+		 << "  --rebuild               run the detectors even if the cache holds the same frames\n"
+		 << "  --random <n>            evaluate <n> random settings within the range of each list instead of the grid\n"
+		 << "  --seed <n>              seed of the random search (default 1)\n"
+		 << "  --top <n>               print the <n> best settings (default 10)\n"
+		 << "  --eps <list>            DBSCAN radius, such as 45,50,55,60,65\n"
+		 << "  --min-weight <list>     weight of a core neighbourhood, such as 2,3,4,5\n"
+		 << "  --haar-fraction <list>  fraction of the HAAR points used (default 1)\n"
+		 << "  --orb-fraction <list>   fraction of the ORB points used (default 0.2,0.3,0.4,0.5)\n"
+		 << "  --sift-fraction <list>  fraction of the SIFT points used (default 0.2,0.3,0.4,0.5)\n"
+		 << "  --haar-weight <list>    weight of the HAAR points (default 0.5)\n"
+		 << "  --orb-weight <list>     weight of the ORB points (default 1)\n"
+		 << "  --sift-weight <list>    weight of the SIFT points (default 0.5,1)\n"
+		 << "  --help                  print this message\n";
+}
+
+/*
+ * Parses a comma separated list of floats, such as "1,0.75,0.5".
+ */
+static vector<float> parse_float_list(const string &list)
+{
+	vector<float> values;
+	stringstream ss(list);
+	string value;
+	while (getline(ss, value, ','))
+	{
+		if (!value.empty())
+			values.push_back(parse_number<float>(value));
+	}
+	return values;
+}
+
+/*
+ * Reports an option value that is not a valid number, then exits.
+ */
+static void invalid_value(const string &program, const string &option, const string &value)
+{
+	cerr << "[ERROR]: invalid value " << value << " for option " << option << endl;
+	print_usage(program);
+	exit(1);
+}
+
+static sweep_config parse_sweep_config(int argc, char **argv)
+{
+	sweep_config config;
+	const string detector_options[] = {"haar", "orb", "sift"};
+
+	for (int i = 1; i < argc; i++)
+	{
+		try
+		{
+			string arg = argv[i];
+			bool has_value = i + 1 < argc;
+			bool parsed = false;
+
+			for (int d = 0; d < DETECTOR_COUNT && has_value && !parsed; d++)
+			{
+				if (arg == "--" + detector_options[d] + "-fraction")
+					config.fractions[d] = parse_float_list(argv[++i]);
+				else if (arg == "--" + detector_options[d] + "-weight")
+					config.weights[d] = parse_float_list(argv[++i]);
+				else
+					continue;
+				parsed = true;
+			}
+			if (parsed)
+				continue;
+
+			if (arg == "--help")
+			{
+				print_usage(argv[0]);
+				exit(0);
+			}
+			else if (arg == "--pack" && has_value)
+				config.dataset_pack = argv[++i];
+			else if (arg == "--scale" && has_value)
+				config.scale = parse_number<float>(argv[++i]);
+			else if (arg == "--cache" && has_value)
+				config.cache = argv[++i];
+			else if (arg == "--rebuild")
+				config.rebuild = true;
+			else if (arg == "--random" && has_value)
+				config.samples = parse_number<int>(argv[++i]);
+			else if (arg == "--seed" && has_value)
+				config.seed = parse_number<unsigned int>(argv[++i]);
+			else if (arg == "--top" && has_value)
+				config.top = parse_number<int>(argv[++i]);
+			else if (arg == "--eps" && has_value)
+				config.eps = parse_float_list(argv[++i]);
+			else if (arg == "--min-weight" && has_value)
+				config.min_weight = parse_float_list(argv[++i]);
+			else
+			{
+				cerr << "[ERROR]: invalid option " << arg << endl;
+				print_usage(argv[0]);
+				exit(1);
+			}
+		}
+		catch (const invalid_argument &)
+		{
+			invalid_value(argv[0], argv[i - 1], argv[i]);
+		}
+		catch (const out_of_range &)
+		{
+			invalid_value(argv[0], argv[i - 1], argv[i]);
+		}
+	}
+
+	bool empty_list = config.eps.empty() || config.min_weight.empty();
+	for (int d = 0; d < DETECTOR_COUNT; d++)
+		empty_list = empty_list || config.fractions[d].empty() || config.weights[d].empty();
+	if (empty_list)
+	{
+		cerr << "[ERROR]: every parameter needs at least one value" << endl;
+		exit(1);
+	}
+	if (config.scale <= 0.0f || config.scale > 1.0f)
+	{
+		cerr << "[ERROR]: scale must be in (0, 1]" << endl;
+		exit(1);
+	}
+	if (config.samples < 0)
+	{
+		cerr << "[ERROR]: the number of random settings must be non negative" << endl;
+		exit(1);
+	}
+	return config;
+}
+
+/*
+ * Runs the detectors once on every frame and records their outputs.
+ *
+ * Parameters:
+ * - filenames: Test images.
+ * - scale: Scale the detectors run at, their points are mapped back to native coordinates.
+ * - cache: Output cache, one entry per frame, marked as failed if it cannot be decoded.
+ */
+static void build_cache(const vector<String> &filenames, float scale, fusion_cache &cache)
+{
+	cout << "[INFO]: Initializing HAAR detector\n";
+	haar_detector cascade;
+	if (!cascade.is_loaded())
+		exit(1);
+	cout << "[INFO]: Initializing ORB detector\n";
+	orb_detector orb;
+	cout << "[INFO]: Initializing SIFT detector\n";
+	sift_detector sift;
+	detection_pipeline<haar_detector, orb_detector, sift_detector> pipeline(cascade, orb, sift);
+
+	frame_decoder decoder;
+	frame_result result(get_num_categories());
+	Mat scaled;
+	for (size_t i = 0; i < filenames.size(); i++)
+	{
+		Mat &img = decoder.decode(filenames[i]);
+		if (img.empty())
+		{
+			cerr << "[ERROR]: Could not open image file " << filenames[i] << endl;
+			cache.add_failed(get_filename(filenames[i]));
+			continue;
+		}
+
+		result.clear();
+		if (scale < 1.0f)
+		{
+			resize(img, scaled, Size(), scale, scale, INTER_AREA);
+			pipeline.detect(scaled, result);
+			result.rescale(static_cast<float>(img.cols) / static_cast<float>(scaled.cols));
+		}
+		else
+			pipeline.detect(img, result);
+
+		cache.add(pipeline, get_filename(filenames[i]), read_boxes(get_label_path(filenames[i])), img, result);
+		cout << "[INFO]: cached " << i + 1 << "/" << filenames.size() << "\n";
+	}
+}
+
+/*
+ * Returns every combination of the values of the parameters.
+ */
+static vector<fusion_setting> make_grid(const sweep_config &config)
+{
+	vector<fusion_setting> settings(1);
+	auto expand = [&](const vector<float> &values, auto assign)
+	{
+		vector<fusion_setting> expanded;
+		for (const fusion_setting &setting : settings)
+		{
+			for (float value : values)
+			{
+				expanded.push_back(setting);
+				assign(expanded.back(), value);
+			}
+		}
+		settings.swap(expanded);
+	};
+
+	expand(config.eps, [](fusion_setting &s, float v)
+		   { s.eps = v; });
+	expand(config.min_weight, [](fusion_setting &s, float v)
+		   { s.min_weight = v; });
+	for (int d = 0; d < DETECTOR_COUNT; d++)
+	{
+		expand(config.fractions[d], [d](fusion_setting &s, float v)
+			   { s.fractions[d] = v; });
+		expand(config.weights[d], [d](fusion_setting &s, float v)
+			   { s.weights[d] = v; });
+	}
+	return settings;
+}
+
+/*
+ * Returns random settings, each parameter drawn uniformly between the lowest and the highest of its values.
+ */
+static vector<fusion_setting> make_random(const sweep_config &config)
+{
+	mt19937 generator(config.seed);
+	auto draw = [&](const vector<float> &values)
+	{
+		auto range = minmax_element(values.begin(), values.end());
+		return uniform_real_distribution<float>(*range.first, *range.second)(generator);
+	};
+
+	vector<fusion_setting> settings(config.samples);
+	for (fusion_setting &setting : settings)
+	{
+		setting.eps = draw(config.eps);
+		setting.min_weight = draw(config.min_weight);
+		for (int d = 0; d < DETECTOR_COUNT; d++)
+		{
+			setting.fractions[d] = draw(config.fractions[d]);
+			setting.weights[d] = draw(config.weights[d]);
+		}
+	}
+	return settings;
+}
+
+int main(int argc, char **argv)
+{
+	sweep_config config = parse_sweep_config(argc, argv);
+
+	if (!config.dataset_pack.empty())
+	{
+		if (!open_dataset_pack(config.dataset_pack))
+		{
+			cerr << "[ERROR]: could not open the dataset pack " << config.dataset_pack << endl;
+			exit(1);
+		}
+		cout << "[INFO]: Reading the dataset from " << config.dataset_pack << "\n";
+	}
+	if (get_num_categories() == 0)
+	{
+		cerr << "[ERROR]: no category found in " << base << endl;
+		exit(1);
+	}
+
+	vector<String> filenames = get_test_images();
+	vector<string> frame_names;
+	for (const String &filename : filenames)
+		frame_names.push_back(get_filename(filename));
+	const vector<string> category_names = get_category_names();
+
+	// stage 1: the detector outputs, run only if the cache does not hold the same frames with the same inputs
+	fusion_cache cache(category_names, config.scale);
+	if (!config.rebuild && cache.load(config.cache) && cache.matches(frame_names))
+		cout << "[INFO]: Reading the detector outputs of " << cache.size() << " frames from " << config.cache << "\n";
+	else
+	{
+		cache = fusion_cache(category_names, config.scale);
+		build_cache(filenames, config.scale, cache);
+		if (!cache.save(config.cache))
+			cerr << "[ERROR]: Could not write the cache " << config.cache << endl;
+	}
+
+	// stage 2: every setting fuses and clusters the cached outputs as its own task
+	vector<fusion_setting> settings = config.samples > 0 ? make_random(config) : make_grid(config);
+	vector<detection_score> scores(settings.size());
+	int64 start = getTickCount();
+	auto evaluate_setting = [&](int k)
+	{
+		static thread_local weighted_points scratch;
+		scores[k] = cache.evaluate(settings[k], category_names, scratch);
+	};
+	run_tasks(static_cast<int>(settings.size()), true, evaluate_setting);
+	double seconds = (getTickCount() - start) / getTickFrequency();
+
+	// best average IoU first, then most detections, then the order of the sweep
+	vector<size_t> ranking(settings.size());
+	iota(ranking.begin(), ranking.end(), 0);
+	stable_sort(ranking.begin(), ranking.end(), [&](size_t a, size_t b)
+				{
+					if (scores[a].average_iou() != scores[b].average_iou())
+						return scores[a].average_iou() > scores[b].average_iou();
+					return scores[a].detected > scores[b].detected; });
+
+	cout << "[INFO]: " << settings.size() << " settings evaluated on " << cache.size() << " frames in " << seconds << " s" << endl;
+	cout << "--------------------------------------------------\n";
+	cout << "eps\tmin weight\tHAAR fraction/weight\tORB fraction/weight\tSIFT fraction/weight\tavg IoU\tdetected\n";
+	for (size_t r = 0; r < ranking.size() && r < static_cast<size_t>(max(config.top, 0)); r++)
+	{
+		const fusion_setting &s = settings[ranking[r]];
+		const detection_score &score = scores[ranking[r]];
+		cout << s.eps << "\t" << s.min_weight;
+		for (int d = 0; d < DETECTOR_COUNT; d++)
+			cout << "\t" << s.fractions[d] << "/" << s.weights[d];
+		cout << "\t" << score.average_iou() << "\t" << score.detected << "/" << score.total << "\n";
+	}
+	return 0;
+}
@@ -1,242 +1,351 @@
 // created by Davide Baggio 2122547
 
-#include "haar_detector.hpp"
-#include "orb_detector.hpp"
-#include "sift_detector.hpp"
-#include "dbscan.hpp"
+#include "frame_processing.hpp"
 #include "detection.hpp"
+#include "dataset_pack.hpp"
+#include "mat_pool.hpp"
+#include "category_table.hpp"
+#include "detection_daemon.hpp"
+#include <memory>
 #include <random>
 
 /*
- * Samples points from a given vector based on their pixel color in an image.
- *
- * Template Parameters:
- * - is_color: One or more color-checking functions that accept a Vec3b and return a bool.
+ * Runs the pipeline on every image at each processing scale and prints the latency/IoU curve.
  *
  * Parameters:
- * - img: The image to sample colors from.
- * - points: Vector of points to be filtered.
- * - around: If true, checks a 3x3 neighborhood around each point; otherwise, checks only the point itself.
- * - col...: Variadic list of color-checking functions.
- *
- * Returns:
- * - A vector of points that satisfy at least one of the color conditions.
+ * - pipeline: The detection pipeline.
+ * - filenames: Test images.
+ * - category_names: Class name of each category, as used in the labels.
+ * - config: Runtime options, its `scale` is overridden by each entry of `scale_sweep`.
+ * - ctx: Buffers and parameters of the processing.
  *
  * Behavior:
- * - If `around` is true, all pixels in the 3x3 neighborhood must satisfy the color condition.
- * - Otherwise, only the pixel at the point's location is checked.
+ * - Frames are decoded at the reduced resolution allowed by each scale, decoding is excluded from the latency,
+ *   nothing is written to the output folder.
  */
-template <typename... is_color>
-vector<Point> sample_vector_by_color(Mat img, vector<Point> points, bool around, is_color... col)
+template <typename pipeline_type>
+void run_scale_sweep(pipeline_type &pipeline, const vector<String> &filenames, const vector<string> &category_names, pipeline_config config, frame_context &ctx)
 {
-	vector<Point> sampled_points;
-	for (int k = 0; k < points.size(); k++)
+	vector<Rect> boxes(category_names.size());
+	vector<pair<float, detection_score>> curve;
+	vector<double> latencies;
+
+	for (float scale : config.scale_sweep)
 	{
-		Point pixel = points[k];
-		if (around)
+		config.scale = scale;
+		pipeline_config frame_config = config;
+		frame_decoder decoder = make_decoder(config, frame_config.scale);
+		detection_score score;
+		double processing_time = 0;
+
+		for (size_t i = 0; i < filenames.size(); i++)
 		{
-			bool in_vec = true;
-			for (int i = -1; i <= 1; i++)
+			Mat &img = decoder.decode(filenames[i]);
+			if (img.empty())
 			{
-				for (int j = -1; j <= 1; j++)
-				{
-					Point p = Point(pixel.x + i, pixel.y + j);
-					if (p.x >= 0 && p.x < img.cols && p.y >= 0 && p.y < img.rows)
-					{
-						Vec3b pixel_color = img.at<Vec3b>(p);
-						if (!((col(pixel_color) || ...)))
-							in_vec = false;
-					}
-				}
+				cerr << "[ERROR]: Could not open image file." << endl;
+				continue;
 			}
-			if (in_vec)
-				sampled_points.push_back(points[k]);
+
+			int64 start = getTickCount();
+			detect_frame(pipeline, img, frame_config, ctx, boxes);
+			processing_time += (getTickCount() - start) / getTickFrequency();
+			for (Rect &box : boxes)
+				box = decoder.to_native(box);
+			score_frame(read_boxes(get_label_path(filenames[i])), category_names, boxes, score);
 		}
-		else
+
+		curve.push_back({scale, score});
+		latencies.push_back(1000.0 * processing_time / max<size_t>(filenames.size(), 1));
+		cout << "[INFO]: scale " << scale << " done\n";
+	}
+
+	cout << "--------------------------------------------------\n";
+	cout << "scale\tms/frame\tavg IoU\tdetected\n";
+	for (size_t k = 0; k < curve.size(); k++)
+	{
+		cout << curve[k].first << "\t" << latencies[k] << "\t" << curve[k].second.average_iou() << "\t"
+			 << curve[k].second.detected << "/" << curve[k].second.total << "\n";
+	}
+}
+
+
+/*
+ * Runs the HAAR and LBP cascades of every category alone and prints their latency/IoU.
+ *
+ * Parameters:
+ * - filenames: Test images of every category.
+ *
+ * Behavior:
+ * - Cascades missing from the dataset are reported and skipped.
+ */
+void run_cascade_benchmark(const vector<String> &filenames)
+{
+	const cascade_type types[] = {CASCADE_HAAR, CASCADE_LBP};
+
+	cout << "category\tcascade\tms/frame\tavg IoU\tdetected\tfalse detections\n";
+	for (const category_info &info : get_categories())
+	{
+		const string &category = info.folder;
+		for (cascade_type type : types)
 		{
-			Vec3b pixel_color = img.at<Vec3b>(pixel);
-			if ((col(pixel_color) || ...))
-				sampled_points.push_back(points[k]);
+			cascade_benchmark result;
+			if (!benchmark_cascade(category, type, filenames, result))
+			{
+				cout << info.name << "\t" << get_cascade_type_name(type) << "\tnot available ("
+					 << get_cascade_path(category, type) << ")\n";
+				continue;
+			}
+			cout << info.name << "\t" << get_cascade_type_name(type) << "\t"
+				 << 1000.0 * result.seconds / max<size_t>(result.frames, 1) << "\t" << result.score.average_iou() << "\t"
+				 << result.score.detected << "/" << result.score.total << "\t" << result.false_detections << "\n";
 		}
 	}
-	return sampled_points;
 }
 
 /*
- * Samples points from multiple sets of points according to specified probability weights.
+ * Serves detection requests on the daemon socket until a shutdown request.
  *
  * Parameters:
- * - points: A vector of vectors, where each inner vector contains points belonging to a category.
- * - weights: A vector of probabilities (between 0 and 1) corresponding to each category.
+ * - config: Runtime options, `daemon_workers` sets of detectors are used.
+ * - detectors: The detectors already loaded, used by the first worker.
+ * - category_names: Class name of each category, written in the replies.
  *
  * Returns:
- * - A vector of sampled points based on the given weights.
+ * - The exit status of the program.
  *
  * Behavior:
- * - Each point is sampled with a probability equal to the weight of its corresponding category.
- * - If the sizes of `points` and `weights` do not match, prints an error and returns an empty vector.
+ * - Every worker owns its detectors, buffers and decoder, so the workers process their frames concurrently.
+ *   Each worker beyond the first loads the models again.
+ * - Frames are decoded at the reduced resolution the processing scale allows, the boxes are replied in
+ *   native coordinates.
  */
-vector<Point> sample_vector_by_weights(vector<vector<Point>> points, vector<double> weights)
+int run_daemon(const pipeline_config &config, detector_set &detectors, const vector<string> &category_names)
 {
-	srand(225472387358296);
-	if (points.size() != weights.size())
+	int num_categories = static_cast<int>(category_names.size());
+	vector<unique_ptr<detector_set>> replicas;
+	vector<detector_set *> workers = {&detectors};
+	for (int w = 1; w < config.daemon_workers; w++)
 	{
-		cout << "[ERROR]: points and weights must have the same size" << endl;
-		return vector<Point>();
+		cout << "[INFO]: Initializing the detectors of worker " << w << "\n";
+		replicas.push_back(make_unique<detector_set>());
+		if (!configure_detectors(config, *replicas.back()))
+			return 1;
+		workers.push_back(replicas.back().get());
 	}
-	vector<Point> sampled_points;
 
-	for (size_t i = 0; i < weights.size(); i++)
+	pipeline_config frame_config = config;
+	vector<frame_decoder> decoders;
+	vector<unique_ptr<frame_context>> contexts;
+	vector<vector<Rect>> worker_boxes(workers.size(), vector<Rect>(num_categories));
+	for (size_t w = 0; w < workers.size(); w++)
 	{
-		for (size_t j = 0; j < points[i].size(); j++)
-		{
-			float random = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-			if (random < weights[i])
-			{
-				sampled_points.push_back(points[i][j]);
-			}
-		}
+		decoders.push_back(make_decoder(config, frame_config.scale));
+		contexts.push_back(make_unique<frame_context>(num_categories, config));
 	}
 
-	return sampled_points;
+	auto detect_request = [&](int w, const daemon_request &request, vector<Rect> &boxes)
+	{
+		frame_decoder &decoder = decoders[w];
+		Mat &img = request.path.empty() ? decoder.decode_buffer(request.image.data(), request.image.size()) : decoder.decode(request.path);
+		if (img.empty())
+			return false;
+
+		detect_frame(workers[w]->pipeline, img, frame_config, *contexts[w], worker_boxes[w]);
+		for (int c = 0; c < num_categories; c++)
+			boxes[c] = decoder.to_native(worker_boxes[w][c]);
+		return true;
+	};
+
+	detection_daemon daemon(config.daemon_socket, config.daemon_workers, category_names);
+	if (!daemon.run(detect_request))
+		return 1;
+	daemon.print_stats(cout);
+	return 0;
 }
 
 int main(int argc, char **argv)
 {
-	// load cascade
-	cout << "[INFO]: Initializing HAAR detector\n";
-	haar_detector cascade;
+	pipeline_config config = parse_config(argc, argv);
 
-	// load ORB detector
-	cout << "[INFO]: Initializing ORB detector\n";
-	orb_detector orb;
+	// memory accounting must be installed before the models are loaded
+	if (config.mem_report || config.mem_sample_ms > 0)
+		enable_mat_tracking();
+	// frame-sized buffers are recycled across frames, on top of the tracking so pooled memory stays accounted for
+	if (config.mat_pool_mb > 0)
+		enable_mat_pool(config.mat_pool_mb << 20);
+	if (config.mem_sample_ms > 0)
+		start_memory_sampler(config.mem_sample_ms, cout);
 
-	// load SIFT detector
-	cout << "[INFO]: Initializing SIFT detector\n";
-	sift_detector sift;
+	// dataset pack, opened before the detectors load their models from it
+	if (!config.dataset_pack.empty())
+	{
+		if (!open_dataset_pack(config.dataset_pack))
+		{
+			cerr << "[ERROR]: could not open the dataset pack " << config.dataset_pack << endl;
+			exit(1);
+		}
+		cout << "[INFO]: Reading the dataset from " << config.dataset_pack << "\n";
+	}
+	if (get_num_categories() == 0)
+	{
+		cerr << "[ERROR]: no category found in " << base << endl;
+		exit(1);
+	}
+
+	// load the cascades and the ORB and SIFT models
+	cout << "[INFO]: Initializing HAAR, ORB and SIFT detectors\n";
+	detector_set detectors;
+	if (!configure_detectors(config, detectors))
+		return 1;
+	orb_detector &orb = detectors.orb;
+	sift_detector &sift = detectors.sift;
+	auto &pipeline = detectors.pipeline;
 
 	cout << "--------------------------------------------------\n";
 
 	// open all images in folder
-	vector<String> sugar_filenames;
-	vector<String> mustard_filenames;
-	vector<String> drill_filenames;
-	glob(base + sugar + img_path, sugar_filenames, false);
-	glob(base + mustard + img_path, mustard_filenames, false);
-	glob(base + drill + img_path, drill_filenames, false);
-	vector<String> filenames;
-	filenames.insert(filenames.end(), sugar_filenames.begin(), sugar_filenames.end());
-	filenames.insert(filenames.end(), mustard_filenames.begin(), mustard_filenames.end());
-	filenames.insert(filenames.end(), drill_filenames.begin(), drill_filenames.end());
+	vector<String> filenames = get_test_images();
+
+	// categories written to the annotations, from the category table
+	const vector<string> category_names = get_category_names();
+	const int num_categories = get_num_categories();
+
+	if (!config.daemon_socket.empty())
+	{
+		int status = run_daemon(config, detectors, category_names);
+		stop_memory_sampler();
+		return status;
+	}
+
+	// per-frame buffers, reused across frames so their capacity is allocated only once
+	frame_context ctx(num_categories, config);
+	vector<Rect> boxes(num_categories);
+
+	if (config.cascade_benchmark)
+	{
+		run_cascade_benchmark(filenames);
+		return 0;
+	}
+
+	if (!config.scale_sweep.empty())
+	{
+		run_scale_sweep(pipeline, filenames, category_names, config, ctx);
+		return 0;
+	}
+
+	// throughput and accuracy of the run
+	detection_score score;
+	double processing_time = 0;
+	double region_area = 0;
+
+	// frames are decoded directly at the reduced resolution the processing scale allows,
+	// the detectors only resize what is left
+	pipeline_config frame_config = config;
+	frame_decoder decoder = make_decoder(config, frame_config.scale);
+	vector<Rect> native_boxes(num_categories);
+	double decode_time = 0;
+
+	// annotations of the run, appended to a single file unless the text format is requested
+	annotation_format format;
+	parse_annotation_format(config.annotations, format);
+	annotation_writer annotations(format, "./output/");
+	if (!annotations.open())
+	{
+		cerr << "[ERROR]: Could not open output annotation file." << endl;
+		return 1;
+	}
 
 	namedWindow("img", WINDOW_NORMAL);
 	for (size_t i = 0; i < filenames.size(); i++)
 	{
-		Mat img = imread(filenames[i], IMREAD_COLOR);
+		int64 decode_start = getTickCount();
+		Mat *decoded;
+		{
+			mem_scope decode_scope(STAGE_DECODE);
+			decoded = &decoder.decode(filenames[i]);
+		}
+		decode_time += (getTickCount() - decode_start) / getTickFrequency();
+		Mat &img = *decoded;
 		if (img.empty())
 		{
 			cerr << "[ERROR]: Could not open image file." << endl;
 			return 1;
 		}
 
-		// detection HAAR
-		vector<Point> s_haar, m_haar, d_haar;
-		cascade.compute_detection(img);
-		vector<vector<Point>> s_haar_points = cascade.get_points();
-		s_haar = s_haar_points[0];
-		s_haar = sample_vector_by_color(img, s_haar, false, is_yellow, is_white);
-		m_haar = s_haar_points[1];
-		s_haar = sample_vector_by_color(img, s_haar, false, is_yellow, is_white);
-		d_haar = s_haar_points[2];
-		// cascade.display_points();
-
-		// detection ORB
-		vector<Point> s_orb, m_orb, d_orb;
-		orb.compute_detection(img);
-		vector<vector<Point>> s_orb_points = orb.get_points(0.4);
-		s_orb = s_orb_points[0];
-		m_orb = s_orb_points[1];
-		d_orb = s_orb_points[2];
-		// orb.display_points(1);
-
-		// detection SIFT
-		vector<Point> s_sift, m_sift, d_sift;
-		sift.compute_detection(img);
-		vector<vector<Point>> s_sift_points = sift.get_points(0.3);
-		s_sift = s_sift_points[0];
-		m_sift = s_sift_points[1];
-		d_sift = s_sift_points[2];
-		// sift.display_points(1);
-
-		// concatenate all detected points
-		vector<Point> s_total;
-		s_total.insert(s_total.end(), s_haar.begin(), s_haar.end());
-		s_total.insert(s_total.end(), s_orb.begin(), s_orb.end());
-		s_total.insert(s_total.end(), s_sift.begin(), s_sift.end());
-		s_total = sample_vector_by_color(img, s_total, false, is_yellow, is_white, is_dark);
-		s_total = sample_vector_by_weights({s_haar, s_orb, s_sift}, {0.5, 1.0, 0.5});
-		vector<Point> m_total;
-		m_total.insert(m_total.end(), m_haar.begin(), m_haar.end());
-		m_total.insert(m_total.end(), m_orb.begin(), m_orb.end());
-		m_total.insert(m_total.end(), m_sift.begin(), m_sift.end());
-		m_total = sample_vector_by_color(img, m_total, false, is_yellow, is_white, is_blue);
-		m_total = sample_vector_by_weights({m_haar, m_orb, m_sift}, {0.5, 1.0, 0.5});
-		vector<Point> d_total;
-		d_total.insert(d_total.end(), d_haar.begin(), d_haar.end());
-		d_total.insert(d_total.end(), d_orb.begin(), d_orb.end());
-		d_total.insert(d_total.end(), d_sift.begin(), d_sift.end());
-		d_total = sample_vector_by_color(img, d_total, false, is_red, is_dark);
-		d_total = sample_vector_by_weights({d_haar, d_orb, d_sift}, {0.5, 1.0, 0.5});
-
-		/* for (size_t i = 0; i < s_total.size(); i++)
-		{
-			circle(img, s_total[i], 4, Scalar(255, 0, 0), 1);
-		}
-		for (size_t i = 0; i < m_total.size(); i++)
-		{
-			circle(img, m_total[i], 4, Scalar(0, 255, 0), 1);
-		}
-		for (size_t i = 0; i < d_total.size(); i++)
-		{
-			circle(img, d_total[i], 4, Scalar(0, 0, 255), 1);
-		} */
+		// the detectors attribute their own work, the per-frame point vectors belong to the fusion
+		mem_scope fusion_scope(STAGE_FUSION);
+		int64 start = getTickCount();
+		detect_frame(pipeline, img, frame_config, ctx, boxes);
+		processing_time += (getTickCount() - start) / getTickFrequency();
 
-		float eps = 55.0f;
-		int minPts = 3;
+		float coverage = region_coverage(ctx.result.get_regions(), img.size());
+		region_area += (ctx.result.get_regions().empty() || coverage > max_region_coverage) ? 1.0f : coverage;
+		for (int c = 0; c < num_categories; c++)
+			native_boxes[c] = decoder.to_native(boxes[c]);
+		score_frame(read_boxes(get_label_path(filenames[i])), category_names, native_boxes, score);
 
-		Rect dense_s = get_dense_cluster(s_total, eps, minPts);
-		rectangle(img, dense_s, Scalar(255, 0, 0), 2);
-
-		Rect dense_m = get_dense_cluster(m_total, eps, minPts);
-		rectangle(img, dense_m, Scalar(0, 255, 0), 2);
-
-		Rect dense_d = get_dense_cluster(d_total, eps, minPts);
-		rectangle(img, dense_d, Scalar(0, 0, 255), 2);
+		// boxes are drawn once every category is fused, the fusion reads the frame colors
+		for (int c = 0; c < num_categories; c++)
+		{
+			rectangle(img, boxes[c], get_categories()[c].display_color, 2);
+		}
 
 		string img_output_path = "./output/" + get_filename(filenames[i]) + "-box.jpg";
-		string txt_output_path = "./output/" + get_filename(filenames[i]) + "-box.txt";
 
+		mem_scope output_scope(STAGE_OUTPUT);
 		cout << "[INFO]: saving images and annotations to files\n";
 
 		imwrite(img_output_path, img);
 
-		ofstream file;
-		file.open(txt_output_path);
-		if (!file.is_open())
+		if (!annotations.write(get_filename(filenames[i]), category_names, native_boxes))
 		{
-			cerr << "[ERROR]: Could not open output txt file." << endl;
+			cerr << "[ERROR]: Could not write the annotations." << endl;
 			return 1;
 		}
-		file << sugar.substr(0, sugar.size() - 1) << " " << dense_s.x << " " << dense_s.y << " " << dense_s.x + dense_s.width << " " << dense_s.y + dense_s.height << endl;
-		file << mustard.substr(0, mustard.size() - 1) << " " << dense_m.x << " " << dense_m.y << " " << dense_m.x + dense_m.width << " " << dense_m.y + dense_m.height << endl;
-		file << drill.substr(0, drill.size() - 1) << " " << dense_d.x << " " << dense_d.y << " " << dense_d.x + dense_d.width << " " << dense_d.y + dense_d.height;
-		file.close();
 
 		/* imshow("img", img);
 		waitKey(0); */
 
 		cout << "--------------------------------------------------\n";
 	}
+	annotations.close();
+
+	cout << "[INFO]: " << (config.cascade ? "adaptive (threshold " + to_string(config.cascade_threshold) + ")" : string("full")) << " pipeline: "
+		 << filenames.size() / max(processing_time, 1e-9) << " frames/s, average IoU " << score.average_iou()
+		 << ", detected " << score.detected << "/" << score.total << endl;
+	cout << "[INFO]: frames decoded at " << decoder.get_scale() << " of their resolution in " << 1000.0 * decode_time / max<size_t>(filenames.size(), 1)
+		 << " ms/frame" << endl;
+	if (config.roi_expand > 0.0f)
+		cout << "[INFO]: ORB/SIFT features extracted on " << 100.0 * region_area / max<size_t>(filenames.size(), 1) << "% of the frame area on average" << endl;
+	if (config.cascade)
+	{
+		const string detector_names[] = {"HAAR", "ORB", "SIFT"};
+		for (int d = 0; d < DETECTOR_COUNT; d++)
+		{
+			size_t frames = ctx.adaptive_stats.runs[d] + ctx.adaptive_stats.skips[d];
+			if (frames == 0)
+				continue;
+			cout << "[INFO]: " << detector_names[d] << " skipped in " << ctx.adaptive_stats.skips[d] << "/" << frames
+				 << " frames (" << 100.0 * ctx.adaptive_stats.skips[d] / frames << "%)" << endl;
+		}
+	}
+
+	if (config.feature_budget_ms > 0.0)
+	{
+		orb.get_budget().print_stats("ORB", cout);
+		sift.get_budget().print_stats("SIFT", cout);
+	}
+	if (config.bounded_views)
+	{
+		orb.get_view_search().print_stats("ORB", cout);
+		sift.get_view_search().print_stats("SIFT", cout);
+	}
+
+	print_mat_pool_stats(cout);
+	stop_memory_sampler();
+	if (config.mem_report)
+		print_memory_report(cout);
 
 	return 0;
 }
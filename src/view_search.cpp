@@ -0,0 +1,81 @@
+// created by Davide Baggio 2122547
+
+#include "view_search.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+view_search::view_search(int num_categories) : view_matches(num_categories), winners(num_categories, -1)
+{
+}
+
+int view_search::select_winner(const vector<vector<DMatch>> &matches, size_t count)
+{
+	int winner = -1;
+	size_t max_matches = 0;
+	for (size_t c = 0; c < count && c < matches.size(); c++)
+	{
+		if (matches[c].size() > max_matches)
+		{
+			max_matches = matches[c].size();
+			winner = static_cast<int>(c);
+		}
+	}
+	return winner;
+}
+
+int view_search::get_winner(int category) const
+{
+	return winners[category];
+}
+
+vector<DMatch> &view_search::get_winning_matches(int category)
+{
+	return view_matches[category][winners[category]];
+}
+
+void view_search::order_views(int category, const vector<int> &views)
+{
+	vector<int> &order = orders[category];
+	const vector<size_t> &estimate = estimates[category];
+	order.resize(views.size());
+	iota(order.begin(), order.end(), 0);
+
+	// highest estimates first, the previous winner before all of them
+	int previous = previous_views[category];
+	stable_sort(order.begin(), order.end(), [&](int a, int b)
+				{
+					bool a_previous = views[a] == previous;
+					bool b_previous = views[b] == previous;
+					if (a_previous != b_previous)
+						return a_previous;
+					return estimate[a] > estimate[b]; });
+
+	vector<size_t> &limits = remaining_limits[category];
+	limits.assign(order.size(), 0);
+	size_t highest = 0;
+	for (size_t k = order.size(); k-- > 0;)
+	{
+		int c = order[k];
+		size_t expected = static_cast<size_t>(ceil(view_bound_margin * estimate[c])) + coarse_subset_stride;
+		highest = max(highest, min(bounds[category][c], expected));
+		limits[k] = highest;
+	}
+}
+
+Mat view_search::coarse_subset(const Mat &descriptors)
+{
+	Mat subset;
+	for (int r = 0; r < descriptors.rows; r += coarse_subset_stride)
+		subset.push_back(descriptors.row(r));
+	return subset;
+}
+
+void view_search::print_stats(const string &name, ostream &out) const
+{
+	if (searches == 0)
+		return;
+	out << "[INFO]: " << name << " bounded view search: " << static_cast<double>(views_evaluated) / searches << " of "
+		<< static_cast<double>(views_available) / searches << " views matched per frame ("
+		<< 100.0 * views_evaluated / max<size_t>(views_available, 1) << "%)" << endl;
+}
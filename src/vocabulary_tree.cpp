@@ -0,0 +1,266 @@
+// created by Davide Baggio 2122547
+
+#include "vocabulary_tree.hpp"
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+// iterations of k-means at each node
+const static int kmeans_iterations = 10;
+
+// seed of the clustering, fixed so the vocabulary is reproducible
+const static uint64 vocabulary_seed = 225472387;
+
+vocabulary_tree::vocabulary_tree(int branching, int depth)
+{
+	this->branching = max(branching, 2);
+	this->depth = max(depth, 1);
+}
+
+Mat vocabulary_tree::to_float(const Mat &descriptors) const
+{
+	if (!binary)
+	{
+		if (descriptors.depth() == CV_32F)
+			return descriptors;
+		Mat converted;
+		descriptors.convertTo(converted, CV_32F);
+		return converted;
+	}
+
+	Mat unpacked(descriptors.rows, descriptors.cols * 8, CV_32F);
+	for (int r = 0; r < descriptors.rows; r++)
+	{
+		const uchar *src = descriptors.ptr<uchar>(r);
+		float *dst = unpacked.ptr<float>(r);
+		for (int c = 0; c < descriptors.cols; c++)
+		{
+			for (int b = 0; b < 8; b++)
+				dst[c * 8 + b] = (src[c] >> b) & 1 ? 1.0f : 0.0f;
+		}
+	}
+	return unpacked;
+}
+
+void vocabulary_tree::build_node(int node_id, const Mat &data, int level)
+{
+	// leaf: too deep or too few descriptors to split
+	if (level == depth || data.rows <= branching)
+	{
+		nodes[node_id].word = num_words++;
+		return;
+	}
+
+	Mat labels, centers;
+	kmeans(data, branching, labels, TermCriteria(TermCriteria::COUNT + TermCriteria::EPS, kmeans_iterations, 1e-3),
+		   1, KMEANS_PP_CENTERS, centers);
+
+	int first = static_cast<int>(nodes.size());
+	nodes[node_id].centers = centers;
+	nodes[node_id].children = first;
+	nodes.resize(nodes.size() + branching);
+
+	for (int c = 0; c < branching; c++)
+	{
+		Mat child_data;
+		for (int r = 0; r < data.rows; r++)
+		{
+			if (labels.at<int>(r, 0) == c)
+				child_data.push_back(data.row(r));
+		}
+		build_node(first + c, child_data, level + 1);
+	}
+}
+
+void vocabulary_tree::build(const vector<vector<Mat>> &model_descriptors, bool binary)
+{
+	this->binary = binary;
+	nodes.clear();
+	inverted.clear();
+	view_category.clear();
+	view_index.clear();
+	num_words = 0;
+	num_categories = static_cast<int>(model_descriptors.size());
+
+	Mat data;
+	for (int i = 0; i < num_categories; i++)
+	{
+		for (int j = 0; j < model_descriptors[i].size(); j++)
+		{
+			view_category.push_back(i);
+			view_index.push_back(j);
+			if (!model_descriptors[i][j].empty())
+				data.push_back(to_float(model_descriptors[i][j]));
+		}
+	}
+	if (data.empty())
+		return;
+
+	theRNG().state = vocabulary_seed;
+	nodes.resize(1);
+	build_node(0, data, 0);
+
+	// term frequencies of each view, then document frequencies of each word
+	size_t num_views = view_category.size();
+	vector<vector<pair<int, float>>> view_words(num_views);
+	vector<int> document_frequency(num_words, 0);
+	for (size_t v = 0; v < num_views; v++)
+	{
+		const Mat &descriptors = model_descriptors[view_category[v]][view_index[v]];
+		if (descriptors.empty())
+			continue;
+
+		Mat rows = to_float(descriptors);
+		vector<int> counts(num_words, 0);
+		for (int r = 0; r < rows.rows; r++)
+			counts[quantize(rows.ptr<float>(r), rows.cols)]++;
+		for (int w = 0; w < num_words; w++)
+		{
+			if (counts[w] == 0)
+				continue;
+			view_words[v].emplace_back(w, static_cast<float>(counts[w]));
+			document_frequency[w]++;
+		}
+	}
+
+	idf.assign(num_words, 0.0f);
+	for (int w = 0; w < num_words; w++)
+	{
+		if (document_frequency[w] > 0)
+			idf[w] = static_cast<float>(log(static_cast<double>(num_views) / document_frequency[w]));
+	}
+
+	inverted.assign(num_words, vector<posting>());
+	for (size_t v = 0; v < num_views; v++)
+	{
+		float total = 0.0f;
+		for (const auto &word : view_words[v])
+			total += word.second * idf[word.first];
+		if (total <= 0.0f)
+			continue;
+		for (const auto &word : view_words[v])
+			inverted[word.first].push_back({static_cast<int>(v), word.second * idf[word.first] / total});
+	}
+}
+
+bool vocabulary_tree::empty() const
+{
+	return nodes.empty();
+}
+
+int vocabulary_tree::get_num_words() const
+{
+	return num_words;
+}
+
+int vocabulary_tree::quantize(const float *descriptor, int length) const
+{
+	int current = 0;
+	while (nodes[current].children >= 0)
+	{
+		const Mat &centers = nodes[current].centers;
+		int best = 0;
+		float best_distance = numeric_limits<float>::max();
+		for (int c = 0; c < centers.rows; c++)
+		{
+			const float *center = centers.ptr<float>(c);
+			float distance = 0.0f;
+			for (int d = 0; d < length; d++)
+			{
+				float diff = descriptor[d] - center[d];
+				distance += diff * diff;
+			}
+			if (distance < best_distance)
+			{
+				best_distance = distance;
+				best = c;
+			}
+		}
+		current = nodes[current].children + best;
+	}
+	return nodes[current].word;
+}
+
+vector<pair<int, float>> vocabulary_tree::bag_of_words(const Mat &descriptors) const
+{
+	Mat rows = to_float(descriptors);
+	vector<int> words(rows.rows);
+	for (int r = 0; r < rows.rows; r++)
+		words[r] = quantize(rows.ptr<float>(r), rows.cols);
+	sort(words.begin(), words.end());
+
+	vector<pair<int, float>> bag;
+	float total = 0.0f;
+	for (size_t r = 0; r < words.size();)
+	{
+		size_t end = r;
+		while (end < words.size() && words[end] == words[r])
+			end++;
+		float weight = static_cast<float>(end - r) * idf[words[r]];
+		if (weight > 0.0f)
+		{
+			bag.emplace_back(words[r], weight);
+			total += weight;
+		}
+		r = end;
+	}
+	for (auto &word : bag)
+		word.second /= total;
+	return bag;
+}
+
+void vocabulary_tree::score_views(const Mat &descriptors, vector<float> &scores) const
+{
+	// score = sum over the shared words of min(q, d), only the inverted lists of the frame words are visited
+	scores.assign(view_category.size(), 0.0f);
+	for (const auto &word : bag_of_words(descriptors))
+	{
+		for (const posting &p : inverted[word.first])
+			scores[p.view] += min(word.second, p.weight);
+	}
+}
+
+void vocabulary_tree::select_views(const Mat &descriptors, int k, vector<vector<int>> &views) const
+{
+	views.assign(num_categories, vector<int>());
+	if (empty() || descriptors.empty())
+		return;
+
+	vector<float> scores;
+	score_views(descriptors, scores);
+
+	vector<vector<int>> ranked(num_categories);
+	for (size_t v = 0; v < view_category.size(); v++)
+		ranked[view_category[v]].push_back(static_cast<int>(v));
+
+	for (int i = 0; i < num_categories; i++)
+	{
+		vector<int> &candidates = ranked[i];
+		size_t count = min(candidates.size(), static_cast<size_t>(max(k, 0)));
+		partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), [&](int a, int b)
+					 { return scores[a] != scores[b] ? scores[a] > scores[b] : a < b; });
+		for (size_t c = 0; c < count; c++)
+			views[i].push_back(view_index[candidates[c]]);
+	}
+}
+
+void vocabulary_tree::select_shared(const Mat &descriptors, int k, vector<vector<int>> &views) const
+{
+	views.assign(num_categories, vector<int>());
+	if (empty() || descriptors.empty())
+		return;
+
+	vector<float> scores;
+	score_views(descriptors, scores);
+
+	// one ranking over the views of all categories, the category of each view comes from the index
+	vector<int> ranked(view_category.size());
+	iota(ranked.begin(), ranked.end(), 0);
+	size_t count = min(ranked.size(), static_cast<size_t>(max(k, 0)));
+	partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(), [&](int a, int b)
+				 { return scores[a] != scores[b] ? scores[a] > scores[b] : a < b; });
+
+	// views sharing no word with the frame are not worth matching in any category
+	for (size_t c = 0; c < count && scores[ranked[c]] > 0.0f; c++)
+		views[view_category[ranked[c]]].push_back(view_index[ranked[c]]);
+}